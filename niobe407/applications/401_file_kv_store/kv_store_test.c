@@ -19,8 +19,13 @@
 
 #include "ohos_run.h"
 #include "cmsis_os2.h"
+#ifdef LOSCFG_DRIVERS_HDF_PLATFORM_SPI
+#include "hdf_base.h"
+#include "littlefs_mount.h"
+#endif
 
 #define TEMP_SIZE 128
+#define KV_MOUNT_WAIT_MS 30000
 #define wifi1_name_key  "talkweb0"
 #define wifi1_passwd_value  "12345678"
 #define wifi2_name_key  "talkweb1"
@@ -29,6 +34,13 @@
 void kvStoreTestEntry(void)
 {
     char temp[TEMP_SIZE] = {0};
+#ifdef LOSCFG_DRIVERS_HDF_PLATFORM_SPI
+    /* the kv files live on littlefs, which may still be mounting in the background */
+    if (LittlefsMountWait(NULL, KV_MOUNT_WAIT_MS) != HDF_SUCCESS) {
+        printf("[wifi manage] littlefs not mounted\n");
+        return;
+    }
+#endif
     UtilsSetValue(wifi1_name_key, wifi1_passwd_value);
     printf("[wifi manage] set key = %s, value = %s\n", wifi1_name_key, wifi1_passwd_value);
     UtilsSetValue(wifi2_name_key, wifi2_passwd_value);
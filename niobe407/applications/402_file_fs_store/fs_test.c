@@ -21,6 +21,10 @@
 #include "los_memory.h"
 #include "los_task.h"
 #include "ohos_run.h"
+#include "hdf_base.h"
+#include "littlefs_mount.h"
+
+#define FS_TEST_MOUNT_WAIT_MS 30000
 
 static void dir_test(const char *path)
 {
@@ -115,6 +119,11 @@ static void write_test(const char *file, const char *data)
 void littlefs_test(void)
 {
     printf("%s\r\n", __func__);
+    /* the mount may still be formatting the partition in the background */
+    if (LittlefsMountWait("/talkweb", FS_TEST_MOUNT_WAIT_MS) != HDF_SUCCESS) {
+        printf("%s: /talkweb not mounted\r\n", __func__);
+        return;
+    }
     dir_test("/talkweb");
     read_test("/talkweb/wifi.cfg", true);
     write_test("/talkweb/wifi.cfg", "ssid:talkweb password:123456");
@@ -0,0 +1,267 @@
+/*
+ * Copyright (c) 2022 Talkweb Co., Ltd.
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include "fs_bench.h"
+
+#define BENCH_BUF_SIZE      4096
+#define BENCH_PATH_MAX      64
+#define BENCH_RAND_OPS      64
+#define BENCH_RAND_BYTES    64
+#define BENCH_OPEN_OPS      50
+#define BENCH_APPEND_OPS    100
+#define BENCH_APPEND_BYTES  32
+#define BENCH_US_PER_SEC    1000000ULL
+
+typedef struct {
+    const char *name;
+    uint32_t fileBytes;
+    uint32_t opBytes;
+    uint32_t ops;
+    int (*run)(const FsBenchOps *ops, const char *path, uint32_t fileBytes, uint32_t opBytes, uint32_t n);
+} FsBenchCase;
+
+static uint8_t g_benchBuf[BENCH_BUF_SIZE];
+static uint32_t g_benchSeed;
+
+static uint32_t BenchRand(void)
+{
+    g_benchSeed = g_benchSeed * 1103515245 + 12345;
+    return g_benchSeed >> 8;
+}
+
+static void BenchFill(uint32_t offset, uint32_t size)
+{
+    for (uint32_t i = 0; i < size; i++) {
+        g_benchBuf[i] = (uint8_t)((offset + i) * 31 + ((offset + i) >> 8));
+    }
+}
+
+static int BenchCheck(uint32_t offset, uint32_t size)
+{
+    for (uint32_t i = 0; i < size; i++) {
+        if (g_benchBuf[i] != (uint8_t)((offset + i) * 31 + ((offset + i) >> 8))) {
+            return -1;
+        }
+    }
+    return 0;
+}
+
+/* the file every read case works on, written outside the timed part */
+static int BenchCreate(const FsBenchOps *ops, const char *path, uint32_t fileBytes, uint32_t opBytes)
+{
+    int fd = ops->open(path, FS_BENCH_CREATE);
+    int ret = 0;
+
+    if (fd < 0) {
+        return -1;
+    }
+    for (uint32_t done = 0; done < fileBytes && ret == 0; done += opBytes) {
+        uint32_t once = (fileBytes - done < opBytes) ? (fileBytes - done) : opBytes;
+        BenchFill(done, once);
+        ret = (ops->write(fd, g_benchBuf, once) == (int)once) ? 0 : -1;
+    }
+    if (ops->close(fd) != 0) {
+        ret = -1;
+    }
+    return ret;
+}
+
+static int SeqWriteRun(const FsBenchOps *ops, const char *path, uint32_t fileBytes, uint32_t opBytes, uint32_t n)
+{
+    (void)n;
+    return BenchCreate(ops, path, fileBytes, opBytes);
+}
+
+static int SeqReadRun(const FsBenchOps *ops, const char *path, uint32_t fileBytes, uint32_t opBytes, uint32_t n)
+{
+    int fd = ops->open(path, FS_BENCH_RDONLY);
+    int ret = 0;
+
+    (void)n;
+    if (fd < 0) {
+        return -1;
+    }
+    for (uint32_t done = 0; done < fileBytes && ret == 0; done += opBytes) {
+        uint32_t once = (fileBytes - done < opBytes) ? (fileBytes - done) : opBytes;
+        ret = (ops->read(fd, g_benchBuf, once) == (int)once) ? BenchCheck(done, once) : -1;
+    }
+    (void)ops->close(fd);
+    return ret;
+}
+
+static int RandReadRun(const FsBenchOps *ops, const char *path, uint32_t fileBytes, uint32_t opBytes, uint32_t n)
+{
+    int fd = ops->open(path, FS_BENCH_RDONLY);
+    int ret = 0;
+
+    if (fd < 0) {
+        return -1;
+    }
+    for (uint32_t i = 0; i < n && ret == 0; i++) {
+        uint32_t offset = BenchRand() % (fileBytes - opBytes + 1);
+        if (ops->seek(fd, offset) != 0 || ops->read(fd, g_benchBuf, opBytes) != (int)opBytes) {
+            ret = -1;
+        } else {
+            ret = BenchCheck(offset, opBytes);
+        }
+    }
+    (void)ops->close(fd);
+    return ret;
+}
+
+/* same pattern at the same offsets, so the file still checks out afterwards */
+static int RandWriteRun(const FsBenchOps *ops, const char *path, uint32_t fileBytes, uint32_t opBytes, uint32_t n)
+{
+    int fd = ops->open(path, FS_BENCH_RDWR);
+    int ret = 0;
+
+    if (fd < 0) {
+        return -1;
+    }
+    for (uint32_t i = 0; i < n && ret == 0; i++) {
+        uint32_t offset = BenchRand() % (fileBytes - opBytes + 1);
+        BenchFill(offset, opBytes);
+        if (ops->seek(fd, offset) != 0 || ops->write(fd, g_benchBuf, opBytes) != (int)opBytes) {
+            ret = -1;
+        }
+    }
+    if (ops->close(fd) != 0) {
+        ret = -1;
+    }
+    return ret;
+}
+
+static int OpenCloseRun(const FsBenchOps *ops, const char *path, uint32_t fileBytes, uint32_t opBytes, uint32_t n)
+{
+    (void)fileBytes;
+    (void)opBytes;
+    for (uint32_t i = 0; i < n; i++) {
+        int fd = ops->open(path, FS_BENCH_RDONLY);
+        if (fd < 0 || ops->close(fd) != 0) {
+            return -1;
+        }
+    }
+    return 0;
+}
+
+static int AppendRun(const FsBenchOps *ops, const char *path, uint32_t opBytes, uint32_t n, int syncEach)
+{
+    int fd = ops->open(path, FS_BENCH_APPEND);
+    int ret = 0;
+
+    if (fd < 0) {
+        return -1;
+    }
+    BenchFill(0, opBytes);
+    for (uint32_t i = 0; i < n && ret == 0; i++) {
+        if (ops->write(fd, g_benchBuf, opBytes) != (int)opBytes || (syncEach && ops->sync(fd) != 0)) {
+            ret = -1;
+        }
+    }
+    if (ops->close(fd) != 0) {
+        ret = -1;
+    }
+    return ret;
+}
+
+static int AppendBufferedRun(const FsBenchOps *ops, const char *path, uint32_t fileBytes, uint32_t opBytes,
+    uint32_t n)
+{
+    (void)fileBytes;
+    return AppendRun(ops, path, opBytes, n, 0);
+}
+
+static int AppendSyncRun(const FsBenchOps *ops, const char *path, uint32_t fileBytes, uint32_t opBytes, uint32_t n)
+{
+    (void)fileBytes;
+    return AppendRun(ops, path, opBytes, n, 1);
+}
+
+#define BENCH_FILE_CASES(size) \
+    {"seq_write", (size), 512, 0, SeqWriteRun}, \
+    {"seq_read", (size), 512, 0, SeqReadRun}, \
+    {"rand_read", (size), BENCH_RAND_BYTES, BENCH_RAND_OPS, RandReadRun}, \
+    {"rand_write", (size), BENCH_RAND_BYTES, BENCH_RAND_OPS, RandWriteRun}
+
+static const FsBenchCase g_fsBenchCases[] = {
+    BENCH_FILE_CASES(4096),
+    BENCH_FILE_CASES(65536),
+    BENCH_FILE_CASES(262144),
+    {"open_close", 4096, 0, BENCH_OPEN_OPS, OpenCloseRun},
+    {"append", 0, BENCH_APPEND_BYTES, BENCH_APPEND_OPS, AppendBufferedRun},
+    {"append_sync", 0, BENCH_APPEND_BYTES, BENCH_APPEND_OPS, AppendSyncRun},
+};
+
+void FsBenchPrintHeader(void)
+{
+    printf("fsbench,label,case,file_bytes,op_bytes,ops,elapsed_us,kb_per_s,us_per_op\n");
+}
+
+void FsBenchReport(const char *label, const char *name, uint32_t fileBytes, uint32_t opBytes, uint32_t ops,
+    uint64_t elapsedUs)
+{
+    uint64_t bytes = (uint64_t)opBytes * ops;
+    uint32_t kbps = (elapsedUs != 0) ? (uint32_t)(bytes * BENCH_US_PER_SEC / 1024 / elapsedUs) : 0;
+    printf("fsbench,%s,%s,%u,%u,%u,%llu,%u,%llu\n", label, name, fileBytes, opBytes, ops,
+        (unsigned long long)elapsedUs, kbps, (unsigned long long)((ops != 0) ? elapsedUs / ops : 0));
+}
+
+static int FsBenchCaseRun(const FsBenchOps *ops, const char *dir, const char *label, const FsBenchCase *c)
+{
+    char path[BENCH_PATH_MAX];
+    uint32_t n = c->ops;
+
+    (void)snprintf(path, sizeof(path), "%s/fsbench_%u.bin", dir, c->fileBytes);
+    if (c->run == OpenCloseRun && BenchCreate(ops, path, c->fileBytes, BENCH_BUF_SIZE) != 0) {
+        return -1;
+    }
+    if (c->run == AppendBufferedRun || c->run == AppendSyncRun) {
+        (void)ops->unlink(path);
+    }
+    if (n == 0) {
+        n = (c->fileBytes + c->opBytes - 1) / c->opBytes;
+    }
+
+    g_benchSeed = c->fileBytes;
+    uint64_t start = ops->nowUs();
+    int ret = c->run(ops, path, c->fileBytes, c->opBytes, n);
+    uint64_t elapsed = ops->nowUs() - start;
+    if (ret != 0) {
+        printf("fsbench,%s,%s,%u,failed\n", label, c->name, c->fileBytes);
+        return -1;
+    }
+
+    FsBenchReport(label, c->name, c->fileBytes, c->opBytes, n, elapsed);
+    return 0;
+}
+
+int FsBenchRun(const FsBenchOps *ops, const char *dir, const char *label)
+{
+    char path[BENCH_PATH_MAX];
+    int failed = 0;
+
+    for (size_t i = 0; i < sizeof(g_fsBenchCases) / sizeof(g_fsBenchCases[0]); i++) {
+        if (FsBenchCaseRun(ops, dir, label, &g_fsBenchCases[i]) != 0) {
+            failed++;
+        }
+    }
+    for (size_t i = 0; i < sizeof(g_fsBenchCases) / sizeof(g_fsBenchCases[0]); i++) {
+        (void)snprintf(path, sizeof(path), "%s/fsbench_%u.bin", dir, g_fsBenchCases[i].fileBytes);
+        (void)ops->unlink(path);
+    }
+    return failed;
+}
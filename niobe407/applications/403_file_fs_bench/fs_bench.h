@@ -0,0 +1,59 @@
+/*
+ * Copyright (c) 2022 Talkweb Co., Ltd.
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef _FS_BENCH_H_
+#define _FS_BENCH_H_
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define FS_BENCH_RDONLY     0
+#define FS_BENCH_RDWR       1   // existing file, read and write
+#define FS_BENCH_CREATE     2   // create or truncate, read and write
+#define FS_BENCH_APPEND     3   // create if missing, writes go to the end
+
+/*
+ * File calls the benchmark runs on, POSIX like with negative returns on
+ * error: the vfs on the board, littlefs over the simulated flash on the host.
+ */
+typedef struct {
+    int (*open)(const char *path, int mode);
+    int (*close)(int fd);
+    int (*read)(int fd, void *buf, uint32_t size);
+    int (*write)(int fd, const void *buf, uint32_t size);
+    int (*seek)(int fd, uint32_t offset);
+    int (*sync)(int fd);
+    int (*unlink)(const char *path);
+    uint64_t (*nowUs)(void);
+} FsBenchOps;
+
+/*
+ * Run every case in dir and print one line per case:
+ *   fsbench,<label>,<case>,<file_bytes>,<op_bytes>,<ops>,<elapsed_us>,<kb_per_s>,<us_per_op>
+ * Returns the number of failed cases.
+ */
+void FsBenchPrintHeader(void);
+void FsBenchReport(const char *label, const char *name, uint32_t fileBytes, uint32_t opBytes, uint32_t ops,
+    uint64_t elapsedUs);
+int FsBenchRun(const FsBenchOps *ops, const char *dir, const char *label);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _FS_BENCH_H_ */
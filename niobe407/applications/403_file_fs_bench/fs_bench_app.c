@@ -0,0 +1,243 @@
+/*
+ * Copyright (c) 2022 Talkweb Co., Ltd.
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <unistd.h>
+#include "los_config.h"
+#include "los_tick.h"
+#include "ohos_run.h"
+#include "hdf_base.h"
+#include "securec.h"
+#include "fs_bench.h"
+#include "littlefs_mount.h"
+#ifdef LOSCFG_NIOBE407_LITTLEFS_CACHE
+#include "littlefs_cache.h"
+#endif
+#ifdef LOSCFG_NIOBE407_LITTLEFS_WRITE_BACK
+#include "littlefs_writeback.h"
+#endif
+#ifdef LOSCFG_NIOBE407_LITTLEFS_STREAM
+#include "littlefs_stream.h"
+#endif
+
+#define FS_BENCH_DIR            "/talkweb"
+#define FS_BENCH_MOUNT_WAIT_MS  30000
+#define FS_BENCH_US_PER_SEC     1000000
+
+static int BenchOpen(const char *path, int mode)
+{
+    static const int flags[] = {
+        [FS_BENCH_RDONLY] = O_RDONLY,
+        [FS_BENCH_RDWR] = O_RDWR,
+        [FS_BENCH_CREATE] = O_RDWR | O_CREAT | O_TRUNC,
+        [FS_BENCH_APPEND] = O_RDWR | O_CREAT | O_APPEND,
+    };
+    return _open(path, flags[mode]);
+}
+
+static int BenchClose(int fd)
+{
+    return _close(fd);
+}
+
+static int BenchRead(int fd, void *buf, uint32_t size)
+{
+    return _read(fd, buf, size);
+}
+
+static int BenchWrite(int fd, const void *buf, uint32_t size)
+{
+    return _write(fd, buf, size);
+}
+
+static int BenchSeek(int fd, uint32_t offset)
+{
+    return (_lseek(fd, offset, SEEK_SET) == (off_t)offset) ? 0 : -1;
+}
+
+static int BenchSync(int fd)
+{
+    return fsync(fd);
+}
+
+static int BenchUnlink(const char *path)
+{
+    return unlink(path);
+}
+
+static uint64_t BenchNowUs(void)
+{
+    return LOS_SysCycleGet() / (OS_SYS_CLOCK / FS_BENCH_US_PER_SEC);
+}
+
+#ifdef LOSCFG_NIOBE407_LITTLEFS_STREAM
+#define NET_BENCH_PATH          FS_BENCH_DIR "/fsbench_net.bin"
+#define NET_BENCH_FILE_BYTES    (1024 * 1024)
+#define NET_BENCH_MSS           1460    // what one tcp segment hands over
+
+static uint8_t g_netSegment[NET_BENCH_MSS];
+
+/* stands in for recv/send, one copy between the network and the buffer given */
+static void NetCopy(uint8_t *dst, const uint8_t *src, uint32_t size)
+{
+    (void)memcpy_s(dst, size, src, size);
+}
+
+static int PosixNetWrite(void)
+{
+    uint8_t buf[NET_BENCH_MSS];
+    int fd = _open(NET_BENCH_PATH, O_RDWR | O_CREAT | O_TRUNC);
+    int ret = 0;
+
+    if (fd < 0) {
+        return -1;
+    }
+    for (uint32_t done = 0; done < NET_BENCH_FILE_BYTES && ret == 0; done += NET_BENCH_MSS) {
+        uint32_t once = (NET_BENCH_FILE_BYTES - done < NET_BENCH_MSS) ? (NET_BENCH_FILE_BYTES - done) : NET_BENCH_MSS;
+        NetCopy(buf, g_netSegment, once);
+        ret = (_write(fd, buf, once) == (ssize_t)once) ? 0 : -1;
+    }
+    return (_close(fd) == 0) ? ret : -1;
+}
+
+static int PosixNetRead(void)
+{
+    uint8_t buf[NET_BENCH_MSS];
+    int fd = _open(NET_BENCH_PATH, O_RDONLY);
+    uint32_t done = 0;
+    ssize_t n;
+
+    if (fd < 0) {
+        return -1;
+    }
+    while ((n = _read(fd, buf, sizeof(buf))) > 0) {
+        NetCopy(g_netSegment, buf, n);
+        done += n;
+    }
+    (void)_close(fd);
+    return (done == NET_BENCH_FILE_BYTES) ? 0 : -1;
+}
+
+/* segments land straight in pool buffers, which go to the stream task whole */
+static int StreamNetWrite(void)
+{
+    LittlefsStream *stream = LittlefsStreamOpen(NET_BENCH_PATH, O_RDWR | O_CREAT | O_TRUNC);
+    int ret = 0;
+
+    if (stream == NULL) {
+        return -1;
+    }
+    for (uint32_t done = 0; done < NET_BENCH_FILE_BYTES && ret == 0;) {
+        uint8_t *buf = LittlefsStreamBufGet(LOS_WAIT_FOREVER);
+        uint32_t fill = 0;
+        while (fill < LITTLEFS_STREAM_BUF_SIZE && done < NET_BENCH_FILE_BYTES) {
+            uint32_t once = LITTLEFS_STREAM_BUF_SIZE - fill;
+            once = (once < NET_BENCH_MSS) ? once : NET_BENCH_MSS;
+            once = (once < NET_BENCH_FILE_BYTES - done) ? once : (NET_BENCH_FILE_BYTES - done);
+            NetCopy(buf + fill, g_netSegment, once);
+            fill += once;
+            done += once;
+        }
+        ret = (LittlefsStreamSubmit(stream, buf, fill) == HDF_SUCCESS) ? 0 : -1;
+    }
+    return (LittlefsStreamClose(stream) == HDF_SUCCESS) ? ret : -1;
+}
+
+static int StreamNetRead(void)
+{
+    LittlefsStream *stream = LittlefsStreamOpen(NET_BENCH_PATH, O_RDONLY);
+    uint32_t done = 0;
+    uint8_t *buf = NULL;
+    int32_t n;
+
+    if (stream == NULL) {
+        return -1;
+    }
+    while ((n = LittlefsStreamRead(stream, &buf, LOS_WAIT_FOREVER)) > 0) {
+        for (int32_t off = 0; off < n; off += NET_BENCH_MSS) {
+            NetCopy(g_netSegment, buf + off, (n - off < NET_BENCH_MSS) ? (n - off) : NET_BENCH_MSS);
+        }
+        LittlefsStreamBufPut(buf);
+        done += n;
+    }
+    (void)LittlefsStreamClose(stream);
+    return (n == 0 && done == NET_BENCH_FILE_BYTES) ? 0 : -1;
+}
+
+/* a network sized transfer through plain posix calls and through the stream api */
+static int NetBenchRun(void)
+{
+    static const struct {
+        const char *name;
+        uint32_t opBytes;
+        int (*run)(void);
+    } cases[] = {
+        {"net_write_posix", NET_BENCH_MSS, PosixNetWrite},
+        {"net_read_posix", NET_BENCH_MSS, PosixNetRead},
+        {"net_write_stream", LITTLEFS_STREAM_BUF_SIZE, StreamNetWrite},
+        {"net_read_stream", LITTLEFS_STREAM_BUF_SIZE, StreamNetRead},
+    };
+    int failed = 0;
+
+    for (size_t i = 0; i < sizeof(cases) / sizeof(cases[0]); i++) {
+        uint64_t start = BenchNowUs();
+        int ret = cases[i].run();
+        uint64_t elapsed = BenchNowUs() - start;
+        if (ret != 0) {
+            printf("fsbench,board,%s,%u,failed\n", cases[i].name, NET_BENCH_FILE_BYTES);
+            failed++;
+            continue;
+        }
+        FsBenchReport("board", cases[i].name, NET_BENCH_FILE_BYTES, cases[i].opBytes,
+            (NET_BENCH_FILE_BYTES + cases[i].opBytes - 1) / cases[i].opBytes, elapsed);
+    }
+    (void)unlink(NET_BENCH_PATH);
+    return failed;
+}
+#endif
+
+static const FsBenchOps g_benchOps = {
+    .open = BenchOpen,
+    .close = BenchClose,
+    .read = BenchRead,
+    .write = BenchWrite,
+    .seek = BenchSeek,
+    .sync = BenchSync,
+    .unlink = BenchUnlink,
+    .nowUs = BenchNowUs,
+};
+
+/* the board runs the cache settings built in, the host build sweeps them */
+void fs_bench(void)
+{
+    if (LittlefsMountWait(FS_BENCH_DIR, FS_BENCH_MOUNT_WAIT_MS) != HDF_SUCCESS) {
+        printf("%s: %s not mounted\r\n", __func__, FS_BENCH_DIR);
+        return;
+    }
+    FsBenchPrintHeader();
+    int failed = FsBenchRun(&g_benchOps, FS_BENCH_DIR, "board");
+#ifdef LOSCFG_NIOBE407_LITTLEFS_STREAM
+    failed += NetBenchRun();
+#endif
+#ifdef LOSCFG_NIOBE407_LITTLEFS_CACHE
+    LittlefsCacheDumpStat();
+#endif
+#ifdef LOSCFG_NIOBE407_LITTLEFS_WRITE_BACK
+    LittlefsWriteBackDumpStat();
+#endif
+    printf("%s: %d cases failed\r\n", __func__, failed);
+}
+OHOS_APP_RUN(fs_bench);
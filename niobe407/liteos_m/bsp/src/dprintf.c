@@ -14,11 +14,27 @@
  */
 
 #include <stdarg.h>
+#include <string.h>
 #include "securec.h"
 #include "los_debug.h"
 #include "los_interrupt.h"
 #include "uart.h"
+#ifdef LOSCFG_NIOBE407_CONSOLE_DMA_TX
+#include "console.h"
+#endif
+#ifdef LOSCFG_NIOBE407_BINARY_LOG
+#include "binlog.h"
+#endif
 
+#ifdef LOSCFG_NIOBE407_CONSOLE_DMA_TX
+/* the console keeps each message in one piece, no need to hold interrupts while it goes out */
+static void dputs(char const *s, int (*pFputc)(int n, FILE *cookie), void *cookie)
+{
+    (void)pFputc;
+    (void)cookie;
+    ConsoleWrite(s, strlen(s));
+}
+#else
 static void dputs(char const *s, int (*pFputc)(int n, FILE *cookie), void *cookie)
 {
     unsigned int intSave;
@@ -29,12 +45,25 @@ static void dputs(char const *s, int (*pFputc)(int n, FILE *cookie), void *cooki
     }
     LOS_IntRestore(intSave);
 }
+#endif
 
+/*
+ * With LOSCFG_NIOBE407_BINARY_LOG, a message sent as a binary frame returns
+ * the size of the frame, not the length of the text: counting the text would
+ * format it on the target, which the frame is there to avoid.
+ */
 int hal_trace_printf(uint32_t attr, const char *fmt, ...)
 {
-    char buf[1024] = { 0 };
     va_list ap;
     va_start(ap, fmt);
+#ifdef LOSCFG_NIOBE407_BINARY_LOG
+    int frame = BinLogPrintf(fmt, ap);
+    if (frame >= 0) {
+        va_end(ap);
+        return frame;
+    }
+#endif
+    char buf[1024] = { 0 };
     int len = vsnprintf_s(buf, sizeof(buf), 1024 - 1, fmt, ap);
     if (len > 0) {
         dputs(buf, UartPutc, 0);
@@ -47,9 +76,16 @@ int hal_trace_printf(uint32_t attr, const char *fmt, ...)
 
 int printf(char const  *fmt, ...)
 {
-    char buf[1024] = { 0 };
     va_list ap;
     va_start(ap, fmt);
+#ifdef LOSCFG_NIOBE407_BINARY_LOG
+    int frame = BinLogPrintf(fmt, ap);
+    if (frame >= 0) {
+        va_end(ap);
+        return frame;
+    }
+#endif
+    char buf[1024] = { 0 };
     int len = vsnprintf_s(buf, sizeof(buf), 1024 - 1, fmt, ap);
     if (len > 0) {
         dputs(buf, UartPutc, 0);
@@ -17,7 +17,11 @@
 #include <string.h>
 #include "stm32f4xx_hal.h"
 
+#ifdef LOSCFG_NIOBE407_SHELL_UART_BAUDRATE
+#define BAUDRATE LOSCFG_NIOBE407_SHELL_UART_BAUDRATE
+#else
 #define BAUDRATE 115200
+#endif
 #define NIOBE_PLLM 4
 #define NIOBE_PLLN 168
 #define NIOBE_PLLQ 7
@@ -14,6 +14,12 @@
  */
 #include <stdbool.h>
 #include "uart.h"
+#ifdef LOSCFG_NIOBE407_CONSOLE_DMA_TX
+#include "console.h"
+#endif
+#ifdef LOSCFG_NIOBE407_BINARY_LOG
+#include "binlog.h"
+#endif
 #include "watch_dog.h"
 #include "devmgr_service_start.h"
 #include "hiview_def.h"
@@ -23,6 +29,14 @@
 
 bool HilogProc_Impl(const HiLogContent *hilogContent, uint32_t len)
 {
+#ifdef LOSCFG_NIOBE407_BINARY_LOG
+    const HiLogCommon *head = &hilogContent->commonContent;
+    uint32_t count = (head->valueNumber < LOG_MULTI_PARA_MAX) ? head->valueNumber : LOG_MULTI_PARA_MAX;
+    if (BinLogWrite(head->level, head->module, head->time * 1000 + head->milli, head->fmt,
+        hilogContent->values, count) >= 0) {
+        return true;
+    }
+#endif
     char tempOutStr[LOG_FMT_MAX_LEN];
     tempOutStr[0] = 0, tempOutStr[1] = 0;
     if (LogContentFmt(tempOutStr, sizeof(tempOutStr), hilogContent) > 0) {
@@ -50,6 +64,9 @@ int HiLogWriteInternal(const char *buffer, size_t bufLen)
 
 void sys_service_config()
 {
+#ifdef LOSCFG_NIOBE407_CONSOLE_DMA_TX
+    ConsoleInit();
+#endif
     HiviewRegisterHilogProc(HilogProc_Impl);
 
 #ifdef LOSCFG_WATCH_DOG
@@ -30,6 +30,8 @@ extern "C" {
 #if defined(USE_FULL_LL_DRIVER)
 
 uint8_t LL_SPI_Transmit(SPI_TypeDef* SPIx ,uint8_t byte);
+uint32_t LL_SPI_DmaInit(SPI_TypeDef* SPIx);
+uint32_t LL_SPI_TransferDma(SPI_TypeDef* SPIx, const uint8_t *txData, uint8_t *rxData, uint32_t len);
 
 #endif /* USE_FULL_LL_DRIVER */
 
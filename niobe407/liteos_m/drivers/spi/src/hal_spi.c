@@ -18,9 +18,51 @@
 #include "hal_spi.h"
 #include "stm32f4xx_ll_bus.h"
 #include "stm32f4xx_ll_rcc.h"
+#include "stm32f4xx_ll_dma.h"
+#include "los_interrupt.h"
+#include "los_sem.h"
 
 #if defined (SPI1) || defined (SPI2) || defined (SPI3) || defined (SPI4) || defined (SPI5) || defined(SPI6)
 
+#define SPI_DMA_NUM             3
+#define SPI_DMA_MAX_LEN         0xFFFF
+#define SPI_DMA_TIMEOUT_TICKS   1000
+#define SPI_DMA_FLAG_ALL        0x3DU
+#define SPI_DMA_FLAG_TE         0x08U
+#define SPI_DMA_FLAG_TC         0x20U
+#define SPI_DMA_CCMRAM_MASK     0xFFFF0000U
+#define SPI_DMA_CCMRAM_BASE     0x10000000U // ccmram is not reachable by dma
+
+typedef struct {
+    SPI_TypeDef *spi;
+    DMA_TypeDef *dma;
+    uint32_t dmaClk;
+    uint32_t channel;
+    uint32_t rxStream;
+    uint32_t txStream;
+    IRQn_Type rxIrq;
+    HWI_PROC_FUNC irqFunc;
+    UINT32 doneSem;
+    BOOL inited;
+    volatile BOOL failed;
+} SpiDmaCtx;
+
+static void SPI1_DMA_IRQ_Func(void);
+static void SPI2_DMA_IRQ_Func(void);
+static void SPI3_DMA_IRQ_Func(void);
+
+/* rx stream completes last, so only its interrupt is used. dma2 stream0 is left to adc */
+static SpiDmaCtx g_spiDmaCtx[SPI_DMA_NUM] = {
+    {SPI1, DMA2, LL_AHB1_GRP1_PERIPH_DMA2, LL_DMA_CHANNEL_3, LL_DMA_STREAM_2, LL_DMA_STREAM_3,
+        DMA2_Stream2_IRQn, SPI1_DMA_IRQ_Func},
+    {SPI2, DMA1, LL_AHB1_GRP1_PERIPH_DMA1, LL_DMA_CHANNEL_0, LL_DMA_STREAM_3, LL_DMA_STREAM_4,
+        DMA1_Stream3_IRQn, SPI2_DMA_IRQ_Func},
+    {SPI3, DMA1, LL_AHB1_GRP1_PERIPH_DMA1, LL_DMA_CHANNEL_0, LL_DMA_STREAM_0, LL_DMA_STREAM_5,
+        DMA1_Stream0_IRQn, SPI3_DMA_IRQ_Func},
+};
+
+static const uint8_t g_dmaFlagShift[] = {0, 6, 16, 22};
+
 uint8_t LL_SPI_Transmit(SPI_TypeDef* SPIx, uint8_t byte)
 {
     uint8_t read, send = byte;
@@ -31,6 +73,180 @@ uint8_t LL_SPI_Transmit(SPI_TypeDef* SPIx, uint8_t byte)
     return read;
 }
 
+static SpiDmaCtx *SpiDmaGetCtx(SPI_TypeDef* SPIx)
+{
+    for (int i = 0; i < SPI_DMA_NUM; i++) {
+        if (g_spiDmaCtx[i].spi == SPIx) {
+            return &g_spiDmaCtx[i];
+        }
+    }
+    return NULL;
+}
+
+static uint32_t SpiDmaGetFlags(DMA_TypeDef *dma, uint32_t stream)
+{
+    uint32_t reg = (stream < LL_DMA_STREAM_4) ? dma->LISR : dma->HISR;
+    return (reg >> g_dmaFlagShift[stream & 0x3]) & SPI_DMA_FLAG_ALL;
+}
+
+static void SpiDmaClearFlags(DMA_TypeDef *dma, uint32_t stream)
+{
+    uint32_t mask = SPI_DMA_FLAG_ALL << g_dmaFlagShift[stream & 0x3];
+    if (stream < LL_DMA_STREAM_4) {
+        dma->LIFCR = mask;
+    } else {
+        dma->HIFCR = mask;
+    }
+}
+
+static void SpiDmaIrqHandler(SpiDmaCtx *ctx)
+{
+    uint32_t flags = SpiDmaGetFlags(ctx->dma, ctx->rxStream);
+    SpiDmaClearFlags(ctx->dma, ctx->rxStream);
+    if ((flags & (SPI_DMA_FLAG_TC | SPI_DMA_FLAG_TE)) == 0) {
+        return;
+    }
+
+    ctx->failed = ((flags & SPI_DMA_FLAG_TE) != 0) ? TRUE : FALSE;
+    LL_DMA_DisableIT_TC(ctx->dma, ctx->rxStream);
+    LL_DMA_DisableIT_TE(ctx->dma, ctx->rxStream);
+    (void)LOS_SemPost(ctx->doneSem);
+}
+
+static void SPI1_DMA_IRQ_Func(void)
+{
+    SpiDmaIrqHandler(&g_spiDmaCtx[0]);
+}
+
+static void SPI2_DMA_IRQ_Func(void)
+{
+    SpiDmaIrqHandler(&g_spiDmaCtx[1]);
+}
+
+static void SPI3_DMA_IRQ_Func(void)
+{
+    SpiDmaIrqHandler(&g_spiDmaCtx[2]);
+}
+
+static void SpiDmaStreamInit(DMA_TypeDef *dma, uint32_t stream, uint32_t channel, uint32_t direction)
+{
+    LL_DMA_DisableStream(dma, stream);
+    LL_DMA_SetChannelSelection(dma, stream, channel);
+    LL_DMA_SetDataTransferDirection(dma, stream, direction);
+    LL_DMA_SetStreamPriorityLevel(dma, stream, LL_DMA_PRIORITY_HIGH);
+    LL_DMA_SetMode(dma, stream, LL_DMA_MODE_NORMAL);
+    LL_DMA_SetPeriphIncMode(dma, stream, LL_DMA_PERIPH_NOINCREMENT);
+    LL_DMA_SetPeriphSize(dma, stream, LL_DMA_PDATAALIGN_BYTE);
+    LL_DMA_SetMemorySize(dma, stream, LL_DMA_MDATAALIGN_BYTE);
+    LL_DMA_DisableFifoMode(dma, stream);
+}
+
+static void SpiDmaStreamStop(DMA_TypeDef *dma, uint32_t stream)
+{
+    LL_DMA_DisableStream(dma, stream);
+    while (LL_DMA_IsEnabledStream(dma, stream));
+}
+
+static BOOL SpiDmaIsCcmram(const uint8_t *buf)
+{
+    return (((uint32_t)buf & SPI_DMA_CCMRAM_MASK) == SPI_DMA_CCMRAM_BASE) ? TRUE : FALSE;
+}
+
+uint32_t LL_SPI_DmaInit(SPI_TypeDef* SPIx)
+{
+    SpiDmaCtx *ctx = SpiDmaGetCtx(SPIx);
+    if (ctx == NULL) {
+        return LOS_NOK;
+    }
+    if (ctx->inited) {
+        return LOS_OK;
+    }
+
+    if (LOS_BinarySemCreate(0, &ctx->doneSem) != LOS_OK) {
+        return LOS_NOK;
+    }
+    LL_AHB1_GRP1_EnableClock(ctx->dmaClk);
+    SpiDmaStreamInit(ctx->dma, ctx->rxStream, ctx->channel, LL_DMA_DIRECTION_PERIPH_TO_MEMORY);
+    SpiDmaStreamInit(ctx->dma, ctx->txStream, ctx->channel, LL_DMA_DIRECTION_MEMORY_TO_PERIPH);
+    LOS_HwiCreate(ctx->rxIrq, 0, 1, ctx->irqFunc, 0);
+    ctx->inited = TRUE;
+
+    return LOS_OK;
+}
+
+static uint32_t SpiDmaTransferOnce(SpiDmaCtx *ctx, const uint8_t *txData, uint8_t *rxData, uint32_t len)
+{
+    static uint8_t dummyTx = 0xFF;
+    static uint8_t rxSink;
+    SPI_TypeDef *SPIx = ctx->spi;
+    DMA_TypeDef *dma = ctx->dma;
+
+    while (LL_SPI_IsActiveFlag_RXNE(SPIx)) {
+        (void)LL_SPI_ReceiveData8(SPIx);
+    }
+    (void)LOS_SemPend(ctx->doneSem, LOS_NO_WAIT); // drop a post left by a timed out transfer
+    SpiDmaClearFlags(dma, ctx->rxStream);
+    SpiDmaClearFlags(dma, ctx->txStream);
+
+    LL_DMA_ConfigAddresses(dma, ctx->rxStream, LL_SPI_DMA_GetRegAddr(SPIx),
+        (rxData != NULL) ? (uint32_t)rxData : (uint32_t)&rxSink, LL_DMA_DIRECTION_PERIPH_TO_MEMORY);
+    LL_DMA_SetMemoryIncMode(dma, ctx->rxStream, (rxData != NULL) ? LL_DMA_MEMORY_INCREMENT : LL_DMA_MEMORY_NOINCREMENT);
+    LL_DMA_SetDataLength(dma, ctx->rxStream, len);
+    LL_DMA_ConfigAddresses(dma, ctx->txStream, (txData != NULL) ? (uint32_t)txData : (uint32_t)&dummyTx,
+        LL_SPI_DMA_GetRegAddr(SPIx), LL_DMA_DIRECTION_MEMORY_TO_PERIPH);
+    LL_DMA_SetMemoryIncMode(dma, ctx->txStream, (txData != NULL) ? LL_DMA_MEMORY_INCREMENT : LL_DMA_MEMORY_NOINCREMENT);
+    LL_DMA_SetDataLength(dma, ctx->txStream, len);
+
+    ctx->failed = FALSE;
+    LL_DMA_EnableIT_TC(dma, ctx->rxStream);
+    LL_DMA_EnableIT_TE(dma, ctx->rxStream);
+    LL_DMA_EnableStream(dma, ctx->rxStream);
+    LL_DMA_EnableStream(dma, ctx->txStream);
+    LL_SPI_EnableDMAReq_RX(SPIx);
+    LL_SPI_EnableDMAReq_TX(SPIx);
+
+    /* the calling task sleeps here, other tasks run while the stream moves the data */
+    UINT32 ret = LOS_SemPend(ctx->doneSem, SPI_DMA_TIMEOUT_TICKS);
+
+    LL_SPI_DisableDMAReq_TX(SPIx);
+    LL_SPI_DisableDMAReq_RX(SPIx);
+    SpiDmaStreamStop(dma, ctx->txStream);
+    SpiDmaStreamStop(dma, ctx->rxStream);
+    while (LL_SPI_IsActiveFlag_BSY(SPIx));
+
+    if ((ret != LOS_OK) || ctx->failed) {
+        return LOS_NOK;
+    }
+    return LOS_OK;
+}
+
+uint32_t LL_SPI_TransferDma(SPI_TypeDef* SPIx, const uint8_t *txData, uint8_t *rxData, uint32_t len)
+{
+    SpiDmaCtx *ctx = SpiDmaGetCtx(SPIx);
+    if ((ctx == NULL) || !ctx->inited) {
+        return LOS_NOK;
+    }
+    if (SpiDmaIsCcmram(txData) || SpiDmaIsCcmram(rxData)) {
+        return LOS_NOK;
+    }
+
+    while (len > 0) {
+        uint32_t once = (len > SPI_DMA_MAX_LEN) ? SPI_DMA_MAX_LEN : len;
+        if (SpiDmaTransferOnce(ctx, txData, rxData, once) != LOS_OK) {
+            return LOS_NOK;
+        }
+        if (txData != NULL) {
+            txData += once;
+        }
+        if (rxData != NULL) {
+            rxData += once;
+        }
+        len -= once;
+    }
+
+    return LOS_OK;
+}
+
 #endif /* defined (SPI1) || defined (SPI2) || defined (SPI3) || defined (SPI4) || defined (SPI5) || defined(SPI6) */
 
 #endif /* USE_FULL_LL_DRIVER */
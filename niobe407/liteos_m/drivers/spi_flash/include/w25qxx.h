@@ -22,14 +22,86 @@
 
 #define W25x_ID 0X4018 // W25Q128  16MB
 
+#define W25X_LAT_BUCKETS 18 // bucket i counts latencies below 2^i ms, the last one the rest
+
+typedef enum {
+    W25X_OP_PAGE_PROGRAM = 0,
+    W25X_OP_SECTOR_ERASE,
+    W25X_OP_BLOCK_ERASE,
+    W25X_OP_CHIP_ERASE,
+    W25X_OP_MAX,
+} W25xOpType;
+
+typedef struct {
+    uint32_t count;
+    uint32_t maxMs;
+    uint64_t totalMs;
+    uint32_t buckets[W25X_LAT_BUCKETS];
+} W25xLatencyStat;
+
+#define W25X_ERASE_TYPES 4
+
+#define W25X_CAP_SFDP           0x01 // geometry below was read from the sfdp tables
+#define W25X_CAP_4BYTE_ADDR     0x02 // chip runs in 4-byte address mode
+#define W25X_CAP_READ_1_1_2     0x04 // dual output/io and quad reads are reported only,
+#define W25X_CAP_READ_1_2_2     0x08 // the hdf spi bus drives a single data line
+#define W25X_CAP_READ_1_1_4     0x10
+#define W25X_CAP_READ_1_4_4     0x20
+
+/* chip geometry found at open, from SFDP or else from the JEDEC ID */
+typedef struct {
+    uint32_t capacity;                      // bytes
+    uint32_t pageSize;                      // program unit, at most 256
+    uint32_t eraseSize[W25X_ERASE_TYPES];   // ascending, 0 for unused slots
+    uint8_t eraseCmd[W25X_ERASE_TYPES];
+    uint8_t addrBytes;
+    uint8_t readCmd;
+    uint8_t readDummyBytes;
+    uint32_t caps;
+} W25xFlashInfo;
+
+/*
+ * One flash chip on a spi bus/cs. Every W25x_Dev* call is serialized per bus,
+ * chips on different buses are driven in parallel. The W25x_* calls without
+ * a device act on the device opened by W25x_InitSpiFlash.
+ */
+typedef struct W25xDev W25xDev;
+
+W25xDev *W25x_DevOpen(uint32_t busNum, uint32_t csNum);
+void W25x_DevClose(W25xDev *dev);
+DevHandle W25x_DevGetSpiHandle(W25xDev *dev);
+W25xDev *W25x_GetDefaultDev(void);
+int32_t W25x_DevRead(W25xDev *dev, uint8_t *pBuffer, uint32_t ReadAddr, uint32_t NumByteToRead);
+int32_t W25x_DevReadUrgent(W25xDev *dev, uint8_t *pBuffer, uint32_t ReadAddr, uint32_t NumByteToRead);
+int32_t W25x_DevWrite(W25xDev *dev, const uint8_t *pBuffer, uint32_t WriteAddr, uint32_t NumByteToWrite);
+int32_t W25x_DevSectorErase(W25xDev *dev, uint32_t SectorAddr);
+int32_t W25x_DevEraseRange(W25xDev *dev, uint32_t EraseAddr, uint32_t NumByteToErase);
+int32_t W25x_DevBulkErase(W25xDev *dev);
+uint32_t W25x_DevReadID(W25xDev *dev);
+int32_t W25x_DevPowerDown(W25xDev *dev);
+int32_t W25x_DevWakeUp(W25xDev *dev);
+int32_t W25x_DevGetLatencyStat(W25xDev *dev, W25xOpType op, W25xLatencyStat *stat);
+uint32_t W25x_DevGetSuspendCount(W25xDev *dev);
+int32_t W25x_DevGetInfo(W25xDev *dev, W25xFlashInfo *info);
+
 uint8_t W25x_InitSpiFlash(uint32_t busNum, uint32_t csNum);
 uint8_t W25x_DeInitSpiFlash(void);
 DevHandle W25x_GetSpiHandle(void);
+uint32_t W25x_GetAllocAvoided(void);
+int32_t W25x_GetFlashInfo(W25xFlashInfo *info);
 void W25x_SectorErase(uint32_t SectorAddr);
+int32_t W25x_EraseRange(uint32_t EraseAddr, uint32_t NumByteToErase);
 void W25x_BulkErase(void);
 void W25x_PageWrite(uint8_t *pBuffer, uint32_t WriteAddr, uint16_t NumByteToWrite);
-void W25x_BufferWrite(uint8_t *pBuffer, uint32_t WriteAddr, uint16_t NumByteToWrite);
-void W25x_BufferRead(uint8_t *pBuffer, uint32_t ReadAddr, uint16_t NumByteToRead);
+void W25x_BufferWrite(uint8_t *pBuffer, uint32_t WriteAddr, uint32_t NumByteToWrite);
+void W25x_BufferRead(uint8_t *pBuffer, uint32_t ReadAddr, uint32_t NumByteToRead);
+int32_t W25x_BufferReadUrgent(uint8_t *pBuffer, uint32_t ReadAddr, uint32_t NumByteToRead);
+uint32_t W25x_GetSuspendCount(void);
+#ifdef LOSCFG_NIOBE407_W25QXX_ASYNC_WRITE
+int32_t W25x_BufferWriteAsync(const uint8_t *pBuffer, uint32_t WriteAddr, uint32_t NumByteToWrite);
+void W25x_FlushAsyncWrite(void);
+uint32_t W25x_GetAsyncPending(void);
+#endif
 uint32_t W25x_ReadID(void);
 uint32_t W25x_ReadDeviceID(void);
 void W25x_StartReadSequence(uint32_t ReadAddr);
@@ -40,6 +112,9 @@ uint8_t W25x_ReadByte(void);
 uint8_t W25x_SendByte(uint8_t byte);
 void W25x_WriteEnable(void);
 void W25x_WaitForWriteEnd(void);
+int32_t W25x_GetLatencyStat(W25xOpType op, W25xLatencyStat *stat);
+void W25x_ResetLatencyStat(void);
+void W25x_DumpLatencyStat(void);
 #endif
 
 #endif /* __BSP_SPIFLASH_H__ */
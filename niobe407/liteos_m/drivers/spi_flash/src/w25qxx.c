@@ -14,6 +14,14 @@
  */
 
 #include "w25qxx.h"
+#include "los_task.h"
+#include "los_mux.h"
+#include "los_queue.h"
+#include "los_event.h"
+#include "los_interrupt.h"
+#ifdef LOSCFG_NIOBE407_W25QXX_USE_DMA
+#include "hal_spi.h"
+#endif
 
 #define W25x_PageSize              256
 #define W25x_PerWritePageSize      256
@@ -26,6 +34,7 @@
 #define W25X_FastReadDual          0x3B
 #define W25X_PageProgram           0x02
 #define W25X_BlockErase            0xD8
+#define W25X_BlockErase32K         0x52
 #define W25X_SectorErase           0x20
 #define W25X_ChipErase             0xC7
 #define W25X_PowerDown             0xB9
@@ -33,263 +42,1088 @@
 #define W25X_DeviceID              0xAB
 #define W25X_ManufactDeviceID      0x90
 #define W25X_JedecDeviceID         0x9F
+#define W25X_EraseSuspend          0x75
+#define W25X_EraseResume           0x7A
+#define W25X_ReadSfdp              0x5A
+#define W25X_Enter4ByteAddr        0xB7
 
 #define WIP_Flag                   0x01
 
 #define Dummy_Byte                 0xFF
 
+#define W25x_MaxCmdLen             6 // opcode, 4 address bytes, dummy
+#define W25x_3ByteAddrLimit        0x1000000
+
+#define W25x_ScratchSize           W25x_PerWritePageSize
+#define W25x_SectorSize            0x1000
+#define W25x_Block32KSize          0x8000
+#define W25x_BlockSize             0x10000
+#define W25x_DmaMinLen             32
+#define W25x_MsPerSecond           1000
+#define W25x_SuspendPolls          100
+#define W25x_UrgentPendTicks       1 // how late an urgent reader notices an erase that started while it waited
+
+#define W25X_MAX_DEVS              LOSCFG_NIOBE407_W25QXX_MAX_DEVS
+
+#define W25X_SFDP_SIGNATURE        0x50444653 // "SFDP", little endian like every sfdp dword
+#define W25X_SFDP_HEADER_LEN       16 // sfdp header and the first parameter header
+#define W25X_SFDP_BFPT_ID          0x00
+#define W25X_BFPT_MIN_DWORDS       9 // JESD216 without revisions
+#define W25X_BFPT_MAX_DWORDS       16 // up to the 4-byte address entry methods of JESD216B
+#define W25X_BFPT_FEATURES         0
+#define W25X_BFPT_DENSITY          1
+#define W25X_BFPT_ERASE_TYPES      7
+#define W25X_BFPT_PAGE_SIZE        10
+#define W25X_BFPT_4BYTE_ENTRY      15
+#define W25X_BFPT_READ_1_1_2       (1U << 16)
+#define W25X_BFPT_ADDR_SHIFT       17
+#define W25X_BFPT_ADDR_MASK        0x3
+#define W25X_BFPT_ADDR_3BYTE_ONLY  0
+#define W25X_BFPT_ADDR_4BYTE_ONLY  2
+#define W25X_BFPT_READ_1_2_2       (1U << 20)
+#define W25X_BFPT_READ_1_4_4       (1U << 21)
+#define W25X_BFPT_READ_1_1_4       (1U << 22)
+#define W25X_BFPT_DENSITY_POW2     (1U << 31)
+#define W25X_BFPT_EN4B_WREN        (1U << 25)
+
 #ifdef LOSCFG_DRIVERS_HDF_PLATFORM_SPI
-DevHandle spiHandle = NULL;
-uint8_t W25x_InitSpiFlash(uint32_t busNum, uint32_t csNum)
+/*
+ * One flash chip. Chips sharing a spi bus also share opMux and busMux, so a bus
+ * runs one command sequence at a time while separate buses work in parallel.
+ * opMux is held for a whole read, program or erase. busMux only orders the
+ * status polls of a running erase against urgent reads, which suspend the
+ * erase instead of waiting for opMux.
+ */
+struct W25xDev {
+    BOOL used;
+    uint32_t busNum;
+    DevHandle spi;
+    W25xFlashInfo info;
+    UINT32 opMux;
+    UINT32 busMux;
+#ifdef LOSCFG_NIOBE407_W25QXX_USE_DMA
+    SPI_TypeDef *dmaPort;
+#endif
+    volatile BOOL eraseActive;
+    uint32_t eraseAddr;
+    uint32_t eraseSize;
+    UINT64 resumeTick;
+    uint32_t suspendCount;
+    uint32_t allocAvoided;
+    W25xLatencyStat latency[W25X_OP_MAX];
+};
+
+static W25xDev g_w25xDevs[W25X_MAX_DEVS];
+/* device behind the W25x_* calls without a device argument */
+static W25xDev *g_w25xDefaultDev = NULL;
+
+/* data phases are clocked against these instead of a per-call heap buffer, the sink is never read */
+static uint8_t g_w25xDummyTx[W25x_ScratchSize];
+static uint8_t g_w25xRxSink[W25x_ScratchSize];
+static BOOL g_w25xDummyTxInited = FALSE;
+
+#ifdef LOSCFG_NIOBE407_W25QXX_ADAPTIVE_WAIT
+typedef struct {
+    uint32_t firstDelayMs; // sleep before the first poll, about the typical time
+    uint32_t pollMs;       // sleep between later polls, 0 polls without sleeping
+} W25xWaitProfile;
+
+/*
+ * W25Q128JV typ/max: page program 0.7/3ms, 4KB erase 45/400ms, 32KB erase 120/1600ms,
+ * 64KB erase 150/2000ms, chip erase 40/200s. A page program ends well within a tick,
+ * so it is only polled. Erases sleep through the typical time, then poll at a short
+ * fixed interval so the end is not overshot by much.
+ */
+static const W25xWaitProfile g_w25xWaitProfile[W25X_OP_MAX] = {
+    {0, 0},
+    {45, 1},
+    {120, 2},
+    {40000, 100},
+};
+#endif
+
+static int32_t W25x_WaitForOpEnd(W25xDev *dev, W25xOpType op);
+static int32_t W25x_SendCmd(W25xDev *dev, uint8_t cmd);
+static int32_t W25x_ReadStatus(W25xDev *dev, uint8_t *status);
+static int32_t W25x_ProgramPageLocked(W25xDev *dev, const uint8_t *pBuffer, uint32_t WriteAddr,
+    uint16_t NumByteToWrite);
+
+#ifdef LOSCFG_NIOBE407_W25QXX_ASYNC_WRITE
+#define W25X_ASYNC_SLOTS           LOSCFG_NIOBE407_W25QXX_ASYNC_SLOTS
+#define W25X_ASYNC_IDLE_EVENT      0x1
+#define W25X_WRITER_STACK_SIZE     0x800
+#define W25X_WRITER_TASK_NAME      "w25x_writer"
+#define W25X_WRITER_TASK_PRIORITY  20
+
+typedef struct {
+    uint32_t addr;
+    uint16_t len;
+    uint16_t slot;
+} W25xAsyncItem;
+
+static uint8_t g_w25xStage[W25X_ASYNC_SLOTS][W25x_PageSize];
+static UINT32 g_w25xFreeQueue;
+static UINT32 g_w25xWorkQueue;
+static EVENT_CB_S g_w25xAsyncEvent;
+static volatile uint32_t g_w25xAsyncPending = 0;
+static BOOL g_w25xAsyncInited = FALSE;
+
+static int32_t W25x_InitAsyncWrite(void);
+#endif
+
+static inline BOOL W25x_DevReady(const W25xDev *dev)
+{
+    if (dev == NULL || dev->spi == NULL) {
+        HDF_LOGE("spi flash haven't been inited\n");
+        return FALSE;
+    }
+    return TRUE;
+}
+
+/* the async queue only feeds the default device, anything else on it waits for the staged pages */
+static inline void W25x_DrainAsync(const W25xDev *dev)
+{
+#ifdef LOSCFG_NIOBE407_W25QXX_ASYNC_WRITE
+    if (dev == g_w25xDefaultDev) {
+        W25x_FlushAsyncWrite();
+    }
+#else
+    (void)dev;
+#endif
+}
+
+#ifdef LOSCFG_NIOBE407_W25QXX_USE_DMA
+static SPI_TypeDef * const g_w25xSpiPort[] = {SPI1, SPI2, SPI3}; // busNum follows spix in hdf.hcs
+
+static void W25x_InitDma(W25xDev *dev, uint32_t busNum)
+{
+    dev->dmaPort = NULL;
+    if (busNum >= sizeof(g_w25xSpiPort) / sizeof(g_w25xSpiPort[0])) {
+        HDF_LOGE("spi bus %u has no dma, use normal transfer\n", busNum);
+        return;
+    }
+    if (LL_SPI_DmaInit(g_w25xSpiPort[busNum]) != LOS_OK) {
+        HDF_LOGE("LL_SPI_DmaInit: failed, use normal transfer\n");
+        return;
+    }
+    dev->dmaPort = g_w25xSpiPort[busNum];
+}
+#endif
+
+#ifdef LOSCFG_NIOBE407_W25QXX_FAST_READ
+/* 0x03 is specified up to 50MHz only, fast read lets the bus run at the highest prescaler */
+static void W25x_SetFastReadSpeed(W25xDev *dev)
+{
+    struct SpiCfg cfg = {0};
+    int32_t ret = SpiGetCfg(dev->spi, &cfg);
+    if (ret != 0) {
+        HDF_LOGE("SpiGetCfg: failed, ret %d\n", ret);
+        return;
+    }
+    cfg.maxSpeedHz = LOSCFG_NIOBE407_W25QXX_FAST_READ_BAUD; // baudRate index as in hdf.hcs
+    ret = SpiSetCfg(dev->spi, &cfg);
+    if (ret != 0) {
+        HDF_LOGE("SpiSetCfg: failed, ret %d\n", ret);
+    }
+}
+#endif
+
+/* opcode and address in the width the chip runs with, returns the command length */
+static uint32_t W25x_FillCmd(const W25xDev *dev, uint8_t *cmd, uint8_t op, uint32_t addr)
+{
+    uint32_t len = 1;
+    cmd[0] = op;
+    for (uint32_t i = dev->info.addrBytes; i > 0; i--) {
+        cmd[len++] = (addr >> ((i - 1) * 8)) & 0xFF;
+    }
+    return len;
+}
+
+static uint32_t W25x_FillReadCmd(const W25xDev *dev, uint8_t *cmd, uint32_t ReadAddr)
+{
+    uint32_t len = W25x_FillCmd(dev, cmd, dev->info.readCmd, ReadAddr);
+    for (uint32_t i = 0; i < dev->info.readDummyBytes; i++) {
+        cmd[len++] = Dummy_Byte;
+    }
+    return len;
+}
+
+/*
+ * Data phase of a command sent with keepCs = 1, cs is released after the last byte.
+ * txData NULL clocks out dummy bytes, rxData NULL drops what the flash sends back.
+ */
+static int32_t W25x_DataPhase(W25xDev *dev, const uint8_t *txData, uint8_t *rxData, uint32_t len)
+{
+    int32_t ret = 0;
+    struct SpiMsg msg = {0};
+
+#ifdef LOSCFG_NIOBE407_W25QXX_USE_DMA
+    /* dma moves all but the last byte, which goes through the hdf driver to raise cs */
+    if ((dev->dmaPort != NULL) && (len > W25x_DmaMinLen)) {
+        if (LL_SPI_TransferDma(dev->dmaPort, txData, rxData, len - 1) != LOS_OK) {
+            HDF_LOGE("LL_SPI_TransferDma: failed\n");
+            ret = HDF_FAILURE;
+        }
+        txData = (txData != NULL) ? (txData + len - 1) : NULL;
+        rxData = (rxData != NULL) ? (rxData + len - 1) : NULL;
+        len = 1;
+    }
+#endif
+
+    /* clock the data in scratch sized pieces, cs stays low until the last one */
+    while (len > 0) {
+        uint32_t once = (len > W25x_ScratchSize) ? W25x_ScratchSize : len;
+        msg.wbuf = (txData != NULL) ? (uint8_t *)txData : g_w25xDummyTx;
+        msg.rbuf = (rxData != NULL) ? rxData : g_w25xRxSink;
+        msg.len = once;
+        msg.keepCs = (once < len) ? 1 : 0;
+        msg.delayUs = 0;
+        if (SpiTransfer(dev->spi, &msg, 1) != 0) {
+            HDF_LOGE("SpiTransfer: failed\n");
+            return HDF_FAILURE;
+        }
+        txData = (txData != NULL) ? (txData + once) : NULL;
+        rxData = (rxData != NULL) ? (rxData + once) : NULL;
+        len -= once;
+    }
+
+    return ret;
+}
+
+static uint32_t W25x_ReadJedecId(W25xDev *dev)
+{
+    uint8_t rbuf[4] = { 0 };
+    uint8_t wbuf[4] = { W25X_JedecDeviceID, Dummy_Byte, Dummy_Byte, Dummy_Byte };
+    struct SpiMsg msg = {0};
+    msg.wbuf = wbuf;
+    msg.rbuf = rbuf;
+    msg.len = sizeof(wbuf);
+    msg.keepCs = 0;
+    msg.delayUs = 0;
+    int32_t ret = SpiTransfer(dev->spi, &msg, 1);
+    if (ret != 0) {
+        HDF_LOGE("SpiTransfer: failed, ret %d\n", ret);
+        return 0;
+    }
+
+    return (rbuf[1] << 16) | (rbuf[2] << 8) | rbuf[3];
+}
+
+/* sfdp is always addressed with 3 bytes and 8 dummy clocks, whatever mode the chip is in */
+static int32_t W25x_ReadSfdp(W25xDev *dev, uint32_t addr, uint8_t *buf, uint32_t len)
+{
+    uint8_t wbuf[5] = {W25X_ReadSfdp, (addr & 0xff0000) >> 16, (addr & 0xff00) >> 8, (addr & 0xff), Dummy_Byte};
+    uint8_t rbuf[5] = {0};
+    struct SpiMsg msg = {0};
+    msg.wbuf = wbuf;
+    msg.rbuf = rbuf;
+    msg.len = sizeof(wbuf);
+    msg.keepCs = 1;
+    msg.delayUs = 0;
+    int32_t ret = SpiTransfer(dev->spi, &msg, 1);
+    if (ret != 0) {
+        HDF_LOGE("SpiTransfer: failed, ret %d\n", ret);
+        return HDF_FAILURE;
+    }
+
+    return W25x_DataPhase(dev, NULL, buf, len);
+}
+
+static uint32_t W25x_LeDword(const uint8_t *p)
+{
+    return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static void W25x_AddEraseType(W25xFlashInfo *info, uint32_t size, uint8_t cmd)
+{
+    int i = W25X_ERASE_TYPES - 1;
+    if (info->eraseSize[i] != 0) {
+        return;
+    }
+    /* keep the table ascending so erase range can walk it from the top */
+    for (; i > 0 && (info->eraseSize[i - 1] == 0 || info->eraseSize[i - 1] > size); i--) {
+        info->eraseSize[i] = info->eraseSize[i - 1];
+        info->eraseCmd[i] = info->eraseCmd[i - 1];
+    }
+    info->eraseSize[i] = size;
+    info->eraseCmd[i] = cmd;
+}
+
+/* what a W25Q part without sfdp has: the density code of the JEDEC ID, 256B pages, 4K/32K/64K erase */
+static void W25x_DefaultInfo(W25xFlashInfo *info, uint32_t jedecId)
+{
+    uint32_t density = jedecId & 0xFF;
+
+    (void)memset_s(info, sizeof(*info), 0, sizeof(*info));
+    info->capacity = (density >= 0x10 && density < 0x20) ? (1U << density) : W25x_3ByteAddrLimit;
+    info->pageSize = W25x_PageSize;
+    W25x_AddEraseType(info, W25x_SectorSize, W25X_SectorErase);
+    W25x_AddEraseType(info, W25x_Block32KSize, W25X_BlockErase32K);
+    W25x_AddEraseType(info, W25x_BlockSize, W25X_BlockErase);
+    info->addrBytes = (info->capacity > W25x_3ByteAddrLimit) ? 4 : 3;
+}
+
+/* JEDEC basic flash parameter table, returns TRUE if write enable must precede 0xB7 */
+static BOOL W25x_ParseBfpt(W25xFlashInfo *info, const uint32_t *dw, uint32_t dwords)
+{
+    uint32_t features = dw[W25X_BFPT_FEATURES];
+    uint32_t density = dw[W25X_BFPT_DENSITY];
+    uint32_t addrMode = (features >> W25X_BFPT_ADDR_SHIFT) & W25X_BFPT_ADDR_MASK;
+
+    if ((density & W25X_BFPT_DENSITY_POW2) == 0) {
+        info->capacity = (density >> 3) + 1; // bits - 1
+    } else {
+        density &= ~W25X_BFPT_DENSITY_POW2;
+        info->capacity = (density >= 34) ? 0x80000000U : (1U << ((density > 3) ? (density - 3) : 0));
+    }
+
+    (void)memset_s(info->eraseSize, sizeof(info->eraseSize), 0, sizeof(info->eraseSize));
+    for (int i = 0; i < W25X_ERASE_TYPES; i++) {
+        uint32_t type = (dw[W25X_BFPT_ERASE_TYPES + i / 2] >> ((i % 2) * 16)) & 0xFFFF;
+        uint32_t sizeExp = type & 0xFF;
+        if (sizeExp != 0 && sizeExp < 32) {
+            W25x_AddEraseType(info, 1U << sizeExp, type >> 8);
+        }
+    }
+    if (info->eraseSize[0] == 0) {
+        W25x_AddEraseType(info, W25x_SectorSize, W25X_SectorErase);
+    }
+
+    if (dwords > W25X_BFPT_PAGE_SIZE) {
+        info->pageSize = 1U << ((dw[W25X_BFPT_PAGE_SIZE] >> 4) & 0xF);
+        if (info->pageSize > W25x_PageSize) {
+            info->pageSize = W25x_PageSize; // programming part of a larger page is fine
+        }
+    }
+
+    info->caps |= (features & W25X_BFPT_READ_1_1_2) ? W25X_CAP_READ_1_1_2 : 0;
+    info->caps |= (features & W25X_BFPT_READ_1_2_2) ? W25X_CAP_READ_1_2_2 : 0;
+    info->caps |= (features & W25X_BFPT_READ_1_1_4) ? W25X_CAP_READ_1_1_4 : 0;
+    info->caps |= (features & W25X_BFPT_READ_1_4_4) ? W25X_CAP_READ_1_4_4 : 0;
+
+    if (addrMode == W25X_BFPT_ADDR_4BYTE_ONLY) {
+        info->addrBytes = 4;
+    } else if (addrMode == W25X_BFPT_ADDR_3BYTE_ONLY && info->capacity > W25x_3ByteAddrLimit) {
+        HDF_LOGE("w25x: no 4-byte addressing, only the first 16MB are used\n");
+        info->capacity = W25x_3ByteAddrLimit;
+        info->addrBytes = 3;
+    } else {
+        info->addrBytes = (info->capacity > W25x_3ByteAddrLimit) ? 4 : 3;
+    }
+
+    return (dwords > W25X_BFPT_4BYTE_ENTRY) && (dw[W25X_BFPT_4BYTE_ENTRY] & W25X_BFPT_EN4B_WREN) != 0;
+}
+
+/*
+ * Find page size, erase types, density and address width of the fitted chip,
+ * and switch it to 4-byte addressing above 16MB. Called at open with opMux
+ * held, before any other command.
+ */
+static void W25x_ProbeGeometry(W25xDev *dev)
+{
+    W25xFlashInfo *info = &dev->info;
+    uint8_t hdr[W25X_SFDP_HEADER_LEN] = {0};
+    uint8_t raw[W25X_BFPT_MAX_DWORDS * sizeof(uint32_t)] = {0};
+    uint32_t dw[W25X_BFPT_MAX_DWORDS] = {0};
+    BOOL wrenFor4Byte = FALSE;
+
+    W25x_DefaultInfo(info, W25x_ReadJedecId(dev));
+    if (W25x_ReadSfdp(dev, 0, hdr, sizeof(hdr)) == HDF_SUCCESS && W25x_LeDword(hdr) == W25X_SFDP_SIGNATURE &&
+        hdr[8] == W25X_SFDP_BFPT_ID && hdr[11] >= W25X_BFPT_MIN_DWORDS) {
+        uint32_t dwords = (hdr[11] > W25X_BFPT_MAX_DWORDS) ? W25X_BFPT_MAX_DWORDS : hdr[11];
+        uint32_t ptr = hdr[12] | (hdr[13] << 8) | (hdr[14] << 16);
+        if (W25x_ReadSfdp(dev, ptr, raw, dwords * sizeof(uint32_t)) == HDF_SUCCESS) {
+            for (uint32_t i = 0; i < dwords; i++) {
+                dw[i] = W25x_LeDword(&raw[i * sizeof(uint32_t)]);
+            }
+            wrenFor4Byte = W25x_ParseBfpt(info, dw, dwords);
+            info->caps |= W25X_CAP_SFDP;
+        }
+    }
+
+#ifdef LOSCFG_NIOBE407_W25QXX_FAST_READ
+    info->readCmd = W25X_FastReadData;
+    info->readDummyBytes = 1;
+#else
+    info->readCmd = W25X_ReadData;
+    info->readDummyBytes = 0;
+#endif
+
+    if (info->addrBytes == 4) {
+        if (wrenFor4Byte) {
+            (void)W25x_SendCmd(dev, W25X_WriteEnable);
+        }
+        (void)W25x_SendCmd(dev, W25X_Enter4ByteAddr);
+        info->caps |= W25X_CAP_4BYTE_ADDR;
+    }
+
+    HDF_LOGI("w25x: %u KB, page %u, erase %u/%u/%u, %u-byte address%s\n", info->capacity / 1024,
+        info->pageSize, info->eraseSize[0], info->eraseSize[1], info->eraseSize[2], info->addrBytes,
+        (info->caps & W25X_CAP_SFDP) ? ", sfdp" : "");
+}
+
+/*
+ * Claim a slot, chips already open on the same bus lend it their locks. The
+ * locks are created up front and deleted again if a sibling's are used, the
+ * kernel calls do not belong inside the interrupt lock.
+ */
+static W25xDev *W25x_DevAlloc(uint32_t busNum)
+{
+    W25xDev *dev = NULL;
+    W25xDev *sibling = NULL;
+    UINT32 opMux;
+    UINT32 busMux;
+
+    if (LOS_MuxCreate(&opMux) != LOS_OK) {
+        return NULL;
+    }
+    if (LOS_MuxCreate(&busMux) != LOS_OK) {
+        (void)LOS_MuxDelete(opMux);
+        return NULL;
+    }
+
+    UINT32 intSave = LOS_IntLock();
+
+    for (int i = 0; i < W25X_MAX_DEVS; i++) {
+        if (!g_w25xDevs[i].used && dev == NULL) {
+            dev = &g_w25xDevs[i];
+        } else if (g_w25xDevs[i].used && g_w25xDevs[i].busNum == busNum) {
+            sibling = &g_w25xDevs[i];
+        }
+    }
+    if (dev != NULL) {
+        (void)memset_s(dev, sizeof(*dev), 0, sizeof(*dev));
+        dev->busNum = busNum;
+        dev->opMux = (sibling != NULL) ? sibling->opMux : opMux;
+        dev->busMux = (sibling != NULL) ? sibling->busMux : busMux;
+        dev->used = TRUE;
+        /* shared by every device, filled before the first one can clock it out */
+        if (!g_w25xDummyTxInited) {
+            (void)memset_s(g_w25xDummyTx, sizeof(g_w25xDummyTx), Dummy_Byte, sizeof(g_w25xDummyTx));
+            g_w25xDummyTxInited = TRUE;
+        }
+    }
+    LOS_IntRestore(intSave);
+
+    if (dev == NULL || sibling != NULL) {
+        (void)LOS_MuxDelete(opMux);
+        (void)LOS_MuxDelete(busMux);
+    }
+
+    return dev;
+}
+
+static void W25x_DevFree(W25xDev *dev)
+{
+    BOOL shared = FALSE;
+    UINT32 intSave = LOS_IntLock();
+
+    dev->used = FALSE;
+    for (int i = 0; i < W25X_MAX_DEVS; i++) {
+        if (g_w25xDevs[i].used && g_w25xDevs[i].busNum == dev->busNum) {
+            shared = TRUE;
+        }
+    }
+    LOS_IntRestore(intSave);
+
+    if (!shared) {
+        (void)LOS_MuxDelete(dev->opMux);
+        (void)LOS_MuxDelete(dev->busMux);
+    }
+}
+
+W25xDev *W25x_DevOpen(uint32_t busNum, uint32_t csNum)
 {
     struct SpiDevInfo spiDevinfo;
     spiDevinfo.busNum = busNum;
     spiDevinfo.csNum = csNum;
-    spiHandle = SpiOpen(&spiDevinfo);
-    if (spiHandle == NULL) {
+
+    W25xDev *dev = W25x_DevAlloc(busNum);
+    if (dev == NULL) {
+        HDF_LOGE("%s: no free w25x device for bus %u\n", __func__, busNum);
+        return NULL;
+    }
+    DevHandle spi = SpiOpen(&spiDevinfo);
+    if (spi == NULL) {
         HDF_LOGE("SpiOpen: failed\n");
+        W25x_DevFree(dev);
+        return NULL;
+    }
+
+    (void)LOS_MuxPend(dev->opMux, LOS_WAIT_FOREVER);
+    dev->spi = spi;
+    W25x_ProbeGeometry(dev);
+#ifdef LOSCFG_NIOBE407_W25QXX_FAST_READ
+    W25x_SetFastReadSpeed(dev);
+#endif
+#ifdef LOSCFG_NIOBE407_W25QXX_USE_DMA
+    W25x_InitDma(dev, busNum);
+#endif
+    (void)LOS_MuxPost(dev->opMux);
+
+    return dev;
+}
+
+void W25x_DevClose(W25xDev *dev)
+{
+    if (dev == NULL || !dev->used) {
+        return;
+    }
+    W25x_DrainAsync(dev);
+    if (dev == g_w25xDefaultDev) {
+        g_w25xDefaultDev = NULL;
+    }
+
+    (void)LOS_MuxPend(dev->opMux, LOS_WAIT_FOREVER);
+    if (dev->spi != NULL) {
+        SpiClose(dev->spi);
+        dev->spi = NULL;
+    }
+    (void)LOS_MuxPost(dev->opMux);
+    W25x_DevFree(dev);
+}
+
+DevHandle W25x_DevGetSpiHandle(W25xDev *dev)
+{
+    return (dev != NULL) ? dev->spi : NULL;
+}
+
+W25xDev *W25x_GetDefaultDev(void)
+{
+    return g_w25xDefaultDev;
+}
+
+uint8_t W25x_InitSpiFlash(uint32_t busNum, uint32_t csNum)
+{
+    if (g_w25xDefaultDev != NULL) {
+        return HDF_SUCCESS;
+    }
+    g_w25xDefaultDev = W25x_DevOpen(busNum, csNum);
+    if (g_w25xDefaultDev == NULL) {
         return HDF_FAILURE;
     }
+#ifdef LOSCFG_NIOBE407_W25QXX_ASYNC_WRITE
+    if (W25x_InitAsyncWrite() != HDF_SUCCESS) {
+        return HDF_FAILURE;
+    }
+#endif
 
     return HDF_SUCCESS;
 }
 
 uint8_t W25x_DeInitSpiFlash(void)
 {
-    if (spiHandle != NULL) {
-        SpiClose(spiHandle);
-    }
+    W25x_DevClose(g_w25xDefaultDev);
 
     return HDF_SUCCESS;
 }
 
 DevHandle W25x_GetSpiHandle(void)
 {
-    return spiHandle;
+    return W25x_DevGetSpiHandle(g_w25xDefaultDev);
 }
 
-void W25x_SectorErase(uint32_t SectorAddr)
+uint32_t W25x_GetAllocAvoided(void)
 {
-    if (spiHandle == NULL) {
-        HDF_LOGE("spi flash haven't been inited\n");
-        return;
+    return (g_w25xDefaultDev != NULL) ? g_w25xDefaultDev->allocAvoided : 0;
+}
+
+int32_t W25x_DevGetInfo(W25xDev *dev, W25xFlashInfo *info)
+{
+    if (!W25x_DevReady(dev) || info == NULL) {
+        return HDF_ERR_INVALID_PARAM;
     }
-    W25x_WriteEnable();
-    W25x_WaitForWriteEnd();
-    uint8_t wbuf[4] = {0x20, (SectorAddr & 0xff0000) >> 16, (SectorAddr & 0xff00) >> 8, (SectorAddr & 0xff)};
-    uint8_t rbuf[4] = {0};
+
+    return memcpy_s(info, sizeof(*info), &dev->info, sizeof(dev->info));
+}
+
+int32_t W25x_GetFlashInfo(W25xFlashInfo *info)
+{
+    return W25x_DevGetInfo(g_w25xDefaultDev, info);
+}
+
+static int32_t W25x_SendCmd(W25xDev *dev, uint8_t cmd)
+{
+    uint8_t wbuf[1] = {cmd};
+    uint8_t rbuf[1] = {0};
     struct SpiMsg msg = {0};
     msg.wbuf = wbuf;
     msg.rbuf = rbuf;
     msg.len = sizeof(wbuf);
     msg.keepCs = 0;
     msg.delayUs = 0;
-    int32_t ret = SpiTransfer(spiHandle, &msg, 1);
+    int32_t ret = SpiTransfer(dev->spi, &msg, 1);
     if (ret != 0) {
         HDF_LOGE("SpiTransfer: failed, ret %d\n", ret);
-        return;
+        return HDF_FAILURE;
     }
-    W25x_WaitForWriteEnd();
+
+    return HDF_SUCCESS;
 }
 
-void W25x_BulkErase(void)
+static int32_t W25x_Erase(W25xDev *dev, uint8_t cmd, uint32_t addr, uint32_t size, W25xOpType op)
 {
-    if (spiHandle == NULL) {
-        HDF_LOGE("spi flash haven't been inited\n");
-        return;
+    if (W25x_SendCmd(dev, W25X_WriteEnable) != HDF_SUCCESS || W25x_WaitForOpEnd(dev, W25X_OP_MAX) != HDF_SUCCESS) {
+        return HDF_FAILURE;
     }
-    W25x_WriteEnable();
-    uint8_t wbuf[1] = {W25X_ChipErase};
-    uint8_t rbuf[1] = {0};
+    uint8_t wbuf[W25x_MaxCmdLen];
+    uint8_t rbuf[W25x_MaxCmdLen] = {0};
     struct SpiMsg msg = {0};
     msg.wbuf = wbuf;
     msg.rbuf = rbuf;
-    msg.len = sizeof(wbuf);
+    msg.len = W25x_FillCmd(dev, wbuf, cmd, addr);
     msg.keepCs = 0;
     msg.delayUs = 0;
-    int32_t ret = SpiTransfer(spiHandle, &msg, 1);
+    int32_t ret = SpiTransfer(dev->spi, &msg, 1);
     if (ret != 0) {
         HDF_LOGE("SpiTransfer: failed, ret %d\n", ret);
-        return;
+        return HDF_FAILURE;
     }
-    W25x_WaitForWriteEnd();
-    return;
+
+    (void)LOS_MuxPend(dev->busMux, LOS_WAIT_FOREVER);
+    dev->eraseAddr = addr;
+    dev->eraseSize = size;
+    dev->eraseActive = TRUE;
+    (void)LOS_MuxPost(dev->busMux);
+
+    ret = W25x_WaitForOpEnd(dev, op);
+
+    (void)LOS_MuxPend(dev->busMux, LOS_WAIT_FOREVER);
+    dev->eraseActive = FALSE;
+    (void)LOS_MuxPost(dev->busMux);
+
+    return ret;
 }
 
-void W25x_PageWrite(uint8_t* pBuffer, uint32_t WriteAddr, uint16_t NumByteToWrite)
+int32_t W25x_DevSectorErase(W25xDev *dev, uint32_t SectorAddr)
 {
-    if (spiHandle == NULL) {
-        HDF_LOGE("spi flash haven't been inited\n");
-        return;
+    if (!W25x_DevReady(dev)) {
+        return HDF_FAILURE;
+    }
+    W25x_DrainAsync(dev);
+
+    (void)LOS_MuxPend(dev->opMux, LOS_WAIT_FOREVER);
+    int32_t ret = W25x_Erase(dev, dev->info.eraseCmd[0], SectorAddr, dev->info.eraseSize[0], W25X_OP_SECTOR_ERASE);
+    (void)LOS_MuxPost(dev->opMux);
+
+    return ret;
+}
+
+void W25x_SectorErase(uint32_t SectorAddr)
+{
+    (void)W25x_DevSectorErase(g_w25xDefaultDev, SectorAddr);
+}
+
+/*
+ * Erase [EraseAddr, EraseAddr + NumByteToErase) with the largest erase unit
+ * that is aligned at each step, 64KB blocks take about the time of 3 sectors.
+ * Both ends must be aligned to the smallest erase unit of the chip.
+ */
+int32_t W25x_DevEraseRange(W25xDev *dev, uint32_t EraseAddr, uint32_t NumByteToErase)
+{
+    if (!W25x_DevReady(dev)) {
+        return HDF_FAILURE;
+    }
+    const W25xFlashInfo *info = &dev->info;
+    if ((EraseAddr % info->eraseSize[0]) != 0 || (NumByteToErase % info->eraseSize[0]) != 0 ||
+        EraseAddr > info->capacity || NumByteToErase > info->capacity - EraseAddr) {
+        HDF_LOGE("%s: 0x%x + 0x%x not erase aligned or out of range\n", __func__, EraseAddr, NumByteToErase);
+        return HDF_ERR_INVALID_PARAM;
+    }
+    W25x_DrainAsync(dev);
+
+    int32_t ret = HDF_SUCCESS;
+    (void)LOS_MuxPend(dev->opMux, LOS_WAIT_FOREVER);
+    while (NumByteToErase > 0 && ret == HDF_SUCCESS) {
+        int type = W25X_ERASE_TYPES - 1;
+        for (; type > 0; type--) {
+            uint32_t size = info->eraseSize[type];
+            if (size != 0 && (EraseAddr % size) == 0 && NumByteToErase >= size) {
+                break;
+            }
+        }
+        uint32_t unit = info->eraseSize[type];
+        ret = W25x_Erase(dev, info->eraseCmd[type], EraseAddr, unit,
+            (unit > W25x_SectorSize) ? W25X_OP_BLOCK_ERASE : W25X_OP_SECTOR_ERASE);
+        EraseAddr += unit;
+        NumByteToErase -= unit;
+    }
+    (void)LOS_MuxPost(dev->opMux);
+
+    return ret;
+}
+
+int32_t W25x_EraseRange(uint32_t EraseAddr, uint32_t NumByteToErase)
+{
+    return W25x_DevEraseRange(g_w25xDefaultDev, EraseAddr, NumByteToErase);
+}
+
+int32_t W25x_DevBulkErase(W25xDev *dev)
+{
+    if (!W25x_DevReady(dev)) {
+        return HDF_FAILURE;
+    }
+    W25x_DrainAsync(dev);
+
+    /* chip erase can not be suspended, urgent reads wait for it like any other */
+    (void)LOS_MuxPend(dev->opMux, LOS_WAIT_FOREVER);
+    int32_t ret = W25x_SendCmd(dev, W25X_WriteEnable);
+    if (ret == HDF_SUCCESS) {
+        ret = W25x_SendCmd(dev, W25X_ChipErase);
+    }
+    if (ret == HDF_SUCCESS) {
+        ret = W25x_WaitForOpEnd(dev, W25X_OP_CHIP_ERASE);
+    }
+    (void)LOS_MuxPost(dev->opMux);
+
+    return ret;
+}
+
+void W25x_BulkErase(void)
+{
+    (void)W25x_DevBulkErase(g_w25xDefaultDev);
+}
+
+/* program one page with opMux held, NumByteToWrite must not cross the page end */
+static int32_t W25x_ProgramPageLocked(W25xDev *dev, const uint8_t *pBuffer, uint32_t WriteAddr,
+    uint16_t NumByteToWrite)
+{
+    if (W25x_SendCmd(dev, W25X_WriteEnable) != HDF_SUCCESS) {
+        return HDF_FAILURE;
     }
-    W25x_WriteEnable();
-    uint8_t wbuf[4] = {W25X_PageProgram, (WriteAddr & 0xff0000) >> 16, (WriteAddr & 0xff00) >> 8, (WriteAddr & 0xff)};
-    uint8_t rbuf[4] = {0};
-    uint8_t *rbuf1 = NULL;
+    uint8_t wbuf[W25x_MaxCmdLen];
+    uint8_t rbuf[W25x_MaxCmdLen] = {0};
     int32_t ret = 0;
 
     struct SpiMsg msg = {0};
     msg.wbuf = wbuf;
     msg.rbuf = rbuf;
-    msg.len = sizeof(wbuf);
+    msg.len = W25x_FillCmd(dev, wbuf, W25X_PageProgram, WriteAddr);
     msg.keepCs = 1;
     msg.delayUs = 0;
-    ret = SpiTransfer(spiHandle, &msg, 1);
+    ret = SpiTransfer(dev->spi, &msg, 1);
     if (ret != 0) {
         HDF_LOGE("SpiTransfer: failed, ret %d\n", ret);
+        return HDF_FAILURE;
     }
 
-    if (NumByteToWrite > W25x_PerWritePageSize) {
-            NumByteToWrite = W25x_PerWritePageSize;
+    if (NumByteToWrite > dev->info.pageSize) {
+            NumByteToWrite = dev->info.pageSize;
             HDF_LOGE("Err: W25x_PageWrite too large!\n");
     }
 
-    rbuf1 = (uint8_t*)OsalMemAlloc(NumByteToWrite);
-    if (rbuf1 == NULL) {
-        HDF_LOGE("malloc failed\n");
-        return;
+    ret = W25x_DataPhase(dev, pBuffer, NULL, NumByteToWrite);
+    dev->allocAvoided++;
+    if (W25x_WaitForOpEnd(dev, W25X_OP_PAGE_PROGRAM) != HDF_SUCCESS) {
+        return HDF_FAILURE;
     }
-    memset_s(rbuf1, NumByteToWrite, 0, NumByteToWrite);
-    msg.wbuf = pBuffer;
-    msg.rbuf = rbuf1;
-    msg.len = NumByteToWrite;
-    msg.keepCs = 0;
-    msg.delayUs = 0;
-    ret = SpiTransfer(spiHandle, &msg, 1);
-    if (ret != 0) {
-        HDF_LOGE("SpiTransfer: failed, ret %d\n", ret);
+
+    return ret;
+}
+
+static int32_t W25x_DevPageWrite(W25xDev *dev, const uint8_t *pBuffer, uint32_t WriteAddr, uint16_t NumByteToWrite)
+{
+    if (!W25x_DevReady(dev)) {
+        return HDF_FAILURE;
     }
-    W25x_WaitForWriteEnd();
-    OsalMemFree(rbuf1);
-    return;
+    (void)LOS_MuxPend(dev->opMux, LOS_WAIT_FOREVER);
+    int32_t ret = W25x_ProgramPageLocked(dev, pBuffer, WriteAddr, NumByteToWrite);
+    (void)LOS_MuxPost(dev->opMux);
+
+    return ret;
+}
+
+void W25x_PageWrite(uint8_t* pBuffer, uint32_t WriteAddr, uint16_t NumByteToWrite)
+{
+    (void)W25x_DevPageWrite(g_w25xDefaultDev, pBuffer, WriteAddr, NumByteToWrite);
 }
 
-void W25x_BufferWrite(uint8_t* pBuffer, uint32_t WriteAddr, uint16_t NumByteToWrite)
+int32_t W25x_DevWrite(W25xDev *dev, const uint8_t *pBuffer, uint32_t WriteAddr, uint32_t NumByteToWrite)
 {
-    uint8_t NumOfPage = 0, NumOfSingle = 0, Addr = 0, count = 0, temp = 0;
+    int32_t ret = HDF_SUCCESS;
 
-    Addr = WriteAddr % W25x_PageSize;
-    count = W25x_PageSize - Addr;
-    NumOfPage =  NumByteToWrite / W25x_PageSize;
-    NumOfSingle = NumByteToWrite % W25x_PageSize;
+    if (!W25x_DevReady(dev)) {
+        return HDF_FAILURE;
+    }
+    W25x_DrainAsync(dev);
 
-    if (Addr == 0) {
-        if (NumOfPage == 0) {
-            W25x_PageWrite(pBuffer, WriteAddr, NumByteToWrite);
-        } else {
-            while (NumOfPage--) {
-                W25x_PageWrite(pBuffer, WriteAddr, W25x_PageSize);
-                WriteAddr +=  W25x_PageSize;
-                pBuffer += W25x_PageSize;
-            }
-            W25x_PageWrite(pBuffer, WriteAddr, NumOfSingle);
+    (void)LOS_MuxPend(dev->opMux, LOS_WAIT_FOREVER);
+    while (NumByteToWrite > 0 && ret == HDF_SUCCESS) {
+        uint32_t count = dev->info.pageSize - (WriteAddr % dev->info.pageSize);
+        if (count > NumByteToWrite) {
+            count = NumByteToWrite;
         }
-    } else {
-        if (NumOfPage == 0) {
-            if (NumOfSingle > count) {
-                temp = NumOfSingle - count;
+        ret = W25x_ProgramPageLocked(dev, pBuffer, WriteAddr, count);
+        WriteAddr += count;
+        pBuffer += count;
+        NumByteToWrite -= count;
+    }
+    (void)LOS_MuxPost(dev->opMux);
 
-                W25x_PageWrite(pBuffer, WriteAddr, count);
-                WriteAddr +=  count;
-                pBuffer += count;
+    return ret;
+}
 
-                W25x_PageWrite(pBuffer, WriteAddr, temp);
-            } else {
-                W25x_PageWrite(pBuffer, WriteAddr, NumByteToWrite);
-            }
-        } else {
-            NumByteToWrite -= count;
-            NumOfPage =  NumByteToWrite / W25x_PageSize;
-            NumOfSingle = NumByteToWrite % W25x_PageSize;
-
-            W25x_PageWrite(pBuffer, WriteAddr, count);
-            WriteAddr +=  count;
-            pBuffer += count;
-
-            while (NumOfPage--) {
-                W25x_PageWrite(pBuffer, WriteAddr, W25x_PageSize);
-                WriteAddr +=  W25x_PageSize;
-                pBuffer += W25x_PageSize;
-            }
+void W25x_BufferWrite(uint8_t* pBuffer, uint32_t WriteAddr, uint32_t NumByteToWrite)
+{
+    (void)W25x_DevWrite(g_w25xDefaultDev, pBuffer, WriteAddr, NumByteToWrite);
+}
 
-            if (NumOfSingle != 0) {
-                W25x_PageWrite(pBuffer, WriteAddr, NumOfSingle);
-            }
+#ifdef LOSCFG_NIOBE407_W25QXX_ASYNC_WRITE
+static void W25x_AsyncWriterEntry(void)
+{
+    W25xAsyncItem item;
+    UINT32 size;
+    UINT32 intSave;
+
+    while (1) {
+        size = sizeof(item);
+        if (LOS_QueueReadCopy(g_w25xWorkQueue, &item, &size, LOS_WAIT_FOREVER) != LOS_OK) {
+            continue;
+        }
+        (void)W25x_DevPageWrite(g_w25xDefaultDev, g_w25xStage[item.slot], item.addr, item.len);
+        (void)LOS_QueueWriteCopy(g_w25xFreeQueue, &item.slot, sizeof(item.slot), LOS_NO_WAIT);
+
+        intSave = LOS_IntLock();
+        g_w25xAsyncPending--;
+        LOS_IntRestore(intSave);
+        if (g_w25xAsyncPending == 0) {
+            (void)LOS_EventWrite(&g_w25xAsyncEvent, W25X_ASYNC_IDLE_EVENT);
         }
     }
 }
 
-void W25x_BufferRead(uint8_t* pBuffer, uint32_t ReadAddr, uint16_t NumByteToRead)
+static int32_t W25x_InitAsyncWrite(void)
 {
-    if (spiHandle == NULL) {
+    UINT32 taskID;
+    TSK_INIT_PARAM_S stTask = {0};
+
+    if (g_w25xAsyncInited) {
+        return HDF_SUCCESS;
+    }
+    if (LOS_EventInit(&g_w25xAsyncEvent) != LOS_OK ||
+        LOS_QueueCreate("w25x_free", W25X_ASYNC_SLOTS, &g_w25xFreeQueue, 0, sizeof(uint16_t)) != LOS_OK ||
+        LOS_QueueCreate("w25x_work", W25X_ASYNC_SLOTS, &g_w25xWorkQueue, 0, sizeof(W25xAsyncItem)) != LOS_OK) {
+        HDF_LOGE("w25x async write queue create failed\n");
+        return HDF_FAILURE;
+    }
+    for (uint16_t i = 0; i < W25X_ASYNC_SLOTS; i++) {
+        (void)LOS_QueueWriteCopy(g_w25xFreeQueue, &i, sizeof(i), LOS_NO_WAIT);
+    }
+
+    stTask.pfnTaskEntry = (TSK_ENTRY_FUNC)W25x_AsyncWriterEntry;
+    stTask.uwStackSize = W25X_WRITER_STACK_SIZE;
+    stTask.pcName = W25X_WRITER_TASK_NAME;
+    stTask.usTaskPrio = W25X_WRITER_TASK_PRIORITY;
+    if (LOS_TaskCreate(&taskID, &stTask) != LOS_OK) {
+        HDF_LOGE("w25x writer task create failed\n");
+        return HDF_FAILURE;
+    }
+    g_w25xAsyncInited = TRUE;
+
+    return HDF_SUCCESS;
+}
+
+/*
+ * Stage the data in page slots and return, the writer task programs them in
+ * order to the default device. Only blocks when all slots are in flight.
+ */
+int32_t W25x_BufferWriteAsync(const uint8_t* pBuffer, uint32_t WriteAddr, uint32_t NumByteToWrite)
+{
+    W25xAsyncItem item;
+    UINT32 size;
+    UINT32 intSave;
+
+    if (!g_w25xAsyncInited || g_w25xDefaultDev == NULL) {
         HDF_LOGE("spi flash haven't been inited\n");
+        return HDF_FAILURE;
+    }
+
+    uint32_t pageSize = g_w25xDefaultDev->info.pageSize;
+    while (NumByteToWrite > 0) {
+        uint32_t count = pageSize - (WriteAddr % pageSize);
+        if (count > NumByteToWrite) {
+            count = NumByteToWrite;
+        }
+        size = sizeof(item.slot);
+        if (LOS_QueueReadCopy(g_w25xFreeQueue, &item.slot, &size, LOS_WAIT_FOREVER) != LOS_OK) {
+            return HDF_FAILURE;
+        }
+        (void)memcpy_s(g_w25xStage[item.slot], W25x_PageSize, pBuffer, count);
+        item.addr = WriteAddr;
+        item.len = count;
+
+        intSave = LOS_IntLock();
+        g_w25xAsyncPending++;
+        LOS_IntRestore(intSave);
+        if (LOS_QueueWriteCopy(g_w25xWorkQueue, &item, sizeof(item), LOS_WAIT_FOREVER) != LOS_OK) {
+            return HDF_FAILURE;
+        }
+        WriteAddr += count;
+        pBuffer += count;
+        NumByteToWrite -= count;
+    }
+
+    return HDF_SUCCESS;
+}
+
+void W25x_FlushAsyncWrite(void)
+{
+    if (!g_w25xAsyncInited) {
         return;
     }
+    while (g_w25xAsyncPending != 0) {
+        (void)LOS_EventRead(&g_w25xAsyncEvent, W25X_ASYNC_IDLE_EVENT,
+            LOS_WAITMODE_OR | LOS_WAITMODE_CLR, LOS_WAIT_FOREVER);
+    }
+}
 
-    int32_t ret = 0;
+uint32_t W25x_GetAsyncPending(void)
+{
+    return g_w25xAsyncPending;
+}
+#endif
 
-    uint8_t wbuf[4] = {W25X_ReadData, (ReadAddr & 0xFF0000) >> 16, (ReadAddr& 0xFF00) >> 8, ReadAddr & 0xFF};
-    uint8_t rbuf[4] = {0};
+static int32_t W25x_ReadData(W25xDev *dev, uint8_t* pBuffer, uint32_t ReadAddr, uint32_t NumByteToRead)
+{
+    uint8_t wbuf[W25x_MaxCmdLen];
+    uint8_t rbuf[W25x_MaxCmdLen] = {0};
     struct SpiMsg msg = {0};
     msg.wbuf = wbuf;
     msg.rbuf = rbuf;
-    msg.len = sizeof(wbuf);
+    msg.len = W25x_FillReadCmd(dev, wbuf, ReadAddr);
     msg.keepCs = 1;
     msg.delayUs = 0;
-    ret = SpiTransfer(spiHandle, &msg, 1);
+    int32_t ret = SpiTransfer(dev->spi, &msg, 1);
     if (ret != 0) {
         HDF_LOGE("SpiTransfer: failed, ret %d\n", ret);
-        return;
+        return HDF_FAILURE;
     }
-    uint8_t *wbuf1 = (uint8_t*)OsalMemAlloc(NumByteToRead);
-    if (wbuf1 == NULL) {
-        HDF_LOGE("malloc failed\n");
-        return;
+    ret = W25x_DataPhase(dev, NULL, pBuffer, NumByteToRead);
+    dev->allocAvoided++;
+
+    return ret;
+}
+
+int32_t W25x_DevRead(W25xDev *dev, uint8_t *pBuffer, uint32_t ReadAddr, uint32_t NumByteToRead)
+{
+    if (!W25x_DevReady(dev)) {
+        return HDF_FAILURE;
     }
-    memset_s(wbuf1, NumByteToRead, 0xff, NumByteToRead);
-    msg.wbuf = wbuf1;
-    msg.rbuf = pBuffer;
-    msg.len = NumByteToRead;
-    msg.keepCs = 0;
-    msg.delayUs = 0;
-    ret = SpiTransfer(spiHandle, &msg, 1);
-    if (ret != 0) {
-        HDF_LOGE("SpiTransfer: failed, ret %d\n", ret);
-        return;
+    W25x_DrainAsync(dev);
+
+    (void)LOS_MuxPend(dev->opMux, LOS_WAIT_FOREVER);
+    int32_t ret = W25x_ReadData(dev, pBuffer, ReadAddr, NumByteToRead);
+    (void)LOS_MuxPost(dev->opMux);
+
+    return ret;
+}
+
+void W25x_BufferRead(uint8_t* pBuffer, uint32_t ReadAddr, uint32_t NumByteToRead)
+{
+    (void)W25x_DevRead(g_w25xDefaultDev, pBuffer, ReadAddr, NumByteToRead);
+}
+
+/* called with busMux held while a sector or block erase is running */
+static int32_t W25x_ReadDuringErase(W25xDev *dev, uint8_t* pBuffer, uint32_t ReadAddr, uint32_t NumByteToRead)
+{
+    uint8_t status = WIP_Flag;
+    int32_t ret;
+
+    if (ReadAddr < dev->eraseAddr + dev->eraseSize && dev->eraseAddr < ReadAddr + NumByteToRead) {
+        return HDF_ERR_DEVICE_BUSY; // nothing valid to read in the block being erased
+    }
+    /* a suspend right after a resume would starve the erase, give it at least one tick */
+    if (LOS_TickCountGet() == dev->resumeTick) {
+        (void)LOS_TaskDelay(1);
     }
 
-    OsalMemFree(wbuf1);
+    if (W25x_SendCmd(dev, W25X_EraseSuspend) != HDF_SUCCESS) {
+        return HDF_FAILURE;
+    }
+    for (uint32_t i = 0; i < W25x_SuspendPolls && (status & WIP_Flag) != 0; i++) {
+        if (W25x_ReadStatus(dev, &status) != HDF_SUCCESS) {
+            break;
+        }
+    }
+    ret = ((status & WIP_Flag) == 0) ? W25x_ReadData(dev, pBuffer, ReadAddr, NumByteToRead) : HDF_ERR_DEVICE_BUSY;
+    (void)W25x_SendCmd(dev, W25X_EraseResume);
+    dev->resumeTick = LOS_TickCountGet();
+    dev->suspendCount++;
 
-    return;
+    return ret;
 }
 
-uint32_t W25x_ReadID(void)
+/*
+ * Read for latency sensitive callers. A sector or block erase in progress is
+ * suspended for the read instead of being waited out, other operations are
+ * waited for on opMux, so its holder inherits the reader's priority. Pages
+ * still staged by W25x_BufferWriteAsync are not flushed.
+ */
+int32_t W25x_DevReadUrgent(W25xDev *dev, uint8_t *pBuffer, uint32_t ReadAddr, uint32_t NumByteToRead)
 {
-    int32_t ret = 0;
-    uint16_t flashId = 0;
-    uint8_t rbuff1[4] = { 0 };
-    uint8_t wbuff1[4] = { W25X_JedecDeviceID, Dummy_Byte, Dummy_Byte, Dummy_Byte };
-    struct SpiMsg msg1 = {0};
-    msg1.wbuf = wbuff1;
-    msg1.rbuf = rbuff1;
-    msg1.len = sizeof(wbuff1);
-    msg1.keepCs = 0;
-    msg1.delayUs = 0;
-    ret = SpiTransfer(spiHandle, &msg1, 1);
-    if (ret != 0) {
-        HDF_LOGE("SpiTransfer: failed, ret %d\n", ret);
-    } else {
-        flashId = msg1.rbuf[2]<<8 | msg1.rbuf[3];
+    int32_t ret;
+
+    if (!W25x_DevReady(dev)) {
+        return HDF_FAILURE;
+    }
+
+    while (1) {
+        if (dev->eraseActive) {
+            (void)LOS_MuxPend(dev->busMux, LOS_WAIT_FOREVER);
+            ret = dev->eraseActive ? W25x_ReadDuringErase(dev, pBuffer, ReadAddr, NumByteToRead) :
+                HDF_ERR_DEVICE_BUSY;
+            (void)LOS_MuxPost(dev->busMux);
+            if (ret != HDF_ERR_DEVICE_BUSY) {
+                return ret;
+            }
+        }
+
+        /* wakes as soon as opMux is posted, the timeout only bounds the wait for an erase to start */
+        if (LOS_MuxPend(dev->opMux, W25x_UrgentPendTicks) == LOS_OK) {
+            ret = W25x_ReadData(dev, pBuffer, ReadAddr, NumByteToRead);
+            (void)LOS_MuxPost(dev->opMux);
+            return ret;
+        }
+    }
+}
+
+int32_t W25x_BufferReadUrgent(uint8_t* pBuffer, uint32_t ReadAddr, uint32_t NumByteToRead)
+{
+    return W25x_DevReadUrgent(g_w25xDefaultDev, pBuffer, ReadAddr, NumByteToRead);
+}
+
+uint32_t W25x_DevGetSuspendCount(W25xDev *dev)
+{
+    return (dev != NULL) ? dev->suspendCount : 0;
+}
+
+uint32_t W25x_GetSuspendCount(void)
+{
+    return W25x_DevGetSuspendCount(g_w25xDefaultDev);
+}
+
+uint32_t W25x_DevReadID(W25xDev *dev)
+{
+    if (!W25x_DevReady(dev)) {
+        return 0;
     }
+    (void)LOS_MuxPend(dev->opMux, LOS_WAIT_FOREVER);
+    uint32_t jedecId = W25x_ReadJedecId(dev);
+    (void)LOS_MuxPost(dev->opMux);
+
+    return jedecId & 0xFFFF;
+}
 
-    return flashId;
+uint32_t W25x_ReadID(void)
+{
+    return W25x_DevReadID(g_w25xDefaultDev);
 }
 
 uint32_t W25x_ReadDeviceID(void)
 {
-    if (spiHandle == NULL) {
-        HDF_LOGE("spi flash haven't been inited\n");
-        return;
+    W25xDev *dev = g_w25xDefaultDev;
+    if (!W25x_DevReady(dev)) {
+        return 0;
     }
     struct SpiMsg msg;
     uint16_t deviceId = 0;
@@ -301,7 +1135,9 @@ uint32_t W25x_ReadDeviceID(void)
     msg.len = sizeof(wbuff);
     msg.keepCs = 0;
     msg.delayUs = 0;
-    ret = SpiTransfer(spiHandle, &msg, 1);
+    (void)LOS_MuxPend(dev->opMux, LOS_WAIT_FOREVER);
+    ret = SpiTransfer(dev->spi, &msg, 1);
+    (void)LOS_MuxPost(dev->opMux);
     if (ret != 0) {
         HDF_LOGE("SpiTransfer: failed, ret %d\n", ret);
     } else {
@@ -313,146 +1149,201 @@ uint32_t W25x_ReadDeviceID(void)
 
 void W25x_StartReadSequence(uint32_t ReadAddr)
 {
-    if (spiHandle == NULL) {
-        HDF_LOGE("spi flash haven't been inited\n");
+    W25xDev *dev = g_w25xDefaultDev;
+    if (!W25x_DevReady(dev)) {
         return;
     }
     struct SpiMsg msg;
-    uint8_t rbuff[4] = { 0 };
-    uint8_t wbuff[4] = { W25X_ReadData, (ReadAddr & 0xff0000) >> 16, (ReadAddr & 0xff00) >> 8, ReadAddr & 0xff };
+    uint8_t rbuff[W25x_MaxCmdLen] = { 0 };
+    uint8_t wbuff[W25x_MaxCmdLen];
     int32_t ret = 0;
     msg.wbuf = wbuff;
     msg.rbuf = rbuff;
-    msg.len = sizeof(wbuff);
+    msg.len = W25x_FillReadCmd(dev, wbuff, ReadAddr);
     msg.keepCs = 0;
     msg.delayUs = 0;
-    ret = SpiTransfer(spiHandle, &msg, 1);
+    (void)LOS_MuxPend(dev->opMux, LOS_WAIT_FOREVER);
+    ret = SpiTransfer(dev->spi, &msg, 1);
+    (void)LOS_MuxPost(dev->opMux);
     if (ret != 0) {
         HDF_LOGE("SpiTransfer: failed, ret %d\n", ret);
     }
 }
 
-void W25x_WriteEnable(void)
+static int32_t W25x_DevSendCmd(W25xDev *dev, uint8_t cmd)
 {
-    if (spiHandle == NULL) {
-        HDF_LOGE("spi flash haven't been inited\n");
-        return;
+    if (!W25x_DevReady(dev)) {
+        return HDF_FAILURE;
     }
+    (void)LOS_MuxPend(dev->opMux, LOS_WAIT_FOREVER);
+    int32_t ret = W25x_SendCmd(dev, cmd);
+    (void)LOS_MuxPost(dev->opMux);
 
-    uint8_t wbuf[1] = {W25X_WriteEnable};
-    uint8_t rbuf[1] = {0};
+    return ret;
+}
+
+void W25x_WriteEnable(void)
+{
+    (void)W25x_DevSendCmd(g_w25xDefaultDev, W25X_WriteEnable);
+}
+
+static int32_t W25x_ReadStatus(W25xDev *dev, uint8_t *status)
+{
+    uint8_t wbuf[2] = {W25X_ReadStatusReg, Dummy_Byte};
+    uint8_t rbuf[2] = {0};
     struct SpiMsg msg = {0};
     msg.wbuf = wbuf;
     msg.rbuf = rbuf;
     msg.len = sizeof(wbuf);
     msg.keepCs = 0;
     msg.delayUs = 0;
-    int32_t ret = SpiTransfer(spiHandle, &msg, 1);
+    int32_t ret = SpiTransfer(dev->spi, &msg, 1);
     if (ret != 0) {
         HDF_LOGE("SpiTransfer: failed, ret %d\n", ret);
+        return HDF_FAILURE;
     }
+    *status = rbuf[1];
 
-    return;
+    return HDF_SUCCESS;
 }
 
-void W25x_WaitForWriteEnd(void)
+static void W25x_RecordLatency(W25xDev *dev, W25xOpType op, uint32_t latencyMs)
 {
-    if (spiHandle == NULL) {
-        HDF_LOGE("spi flash haven't been inited\n");
-        return;
+    W25xLatencyStat *stat = &dev->latency[op];
+    uint32_t bucket = 0;
+    while ((latencyMs >> bucket) != 0 && bucket < W25X_LAT_BUCKETS - 1) {
+        bucket++;
+    }
+    stat->buckets[bucket]++;
+    stat->count++;
+    stat->totalMs += latencyMs;
+    if (latencyMs > stat->maxMs) {
+        stat->maxMs = latencyMs;
     }
+}
 
-    uint8_t FLASH_Status = 0;
+/*
+ * Poll WIP until the operation is done, HDF_FAILURE if the status can not be
+ * read. With the adaptive wait the task sleeps through the typical duration of
+ * an erase and then between polls, so lower priority tasks run during erases
+ * instead of being starved by the status loop.
+ */
+static int32_t W25x_WaitForOpEnd(W25xDev *dev, W25xOpType op)
+{
+    UINT64 start = LOS_TickCountGet();
+    uint8_t status = 0;
+#ifdef LOSCFG_NIOBE407_W25QXX_ADAPTIVE_WAIT
+    const W25xWaitProfile *profile = &g_w25xWaitProfile[(op < W25X_OP_MAX) ? op : W25X_OP_PAGE_PROGRAM];
 
-    /* Send "Read Status Register" instruction */
-    uint8_t wbuf[1] = {W25X_ReadStatusReg};
-    uint8_t wbuf1[1] = {0xff};
-    uint8_t rbuf[1] = {0};
-    struct SpiMsg msg = {0};
-    msg.wbuf = wbuf;
-    msg.rbuf = rbuf;
-    msg.len = sizeof(wbuf);
-    msg.keepCs = 1;
-    msg.delayUs = 0;
-    int32_t ret = SpiTransfer(spiHandle, &msg, 1);
-    if (ret != 0) {
-        HDF_LOGE("SpiTransfer: failed, ret %d\n", ret);
+    if (profile->firstDelayMs > 0) {
+        (void)LOS_TaskDelay(LOS_MS2Tick(profile->firstDelayMs));
     }
+#endif
 
-    /* Loop as long as the memory is busy with a write cycle */
-    do {
-        msg.wbuf = wbuf1;
-        msg.rbuf = rbuf;
-        msg.len = sizeof(wbuf1);
-        msg.keepCs = 1;
-        msg.delayUs = 0;
-
-        ret = SpiTransfer(spiHandle, &msg, 1);
-        if (ret != 0) {
-            HDF_LOGE("SpiTransfer: failed, ret %d\n", ret);
+    while (1) {
+        (void)LOS_MuxPend(dev->busMux, LOS_WAIT_FOREVER);
+        int32_t ret = W25x_ReadStatus(dev, &status);
+        (void)LOS_MuxPost(dev->busMux);
+        if (ret != HDF_SUCCESS) {
+            HDF_LOGE("%s: status read failed\n", __func__);
+            return HDF_FAILURE;
         }
-        FLASH_Status = rbuf[0];
+        if ((status & WIP_Flag) == 0) {
+            break;
+        }
+#ifdef LOSCFG_NIOBE407_W25QXX_ADAPTIVE_WAIT
+        if (profile->pollMs > 0) {
+            (void)LOS_TaskDelay(LOS_MS2Tick(profile->pollMs));
+        }
+#endif
     }
-    while ((FLASH_Status & WIP_Flag) == 1); /* Write in progress */
-
-    msg.wbuf = wbuf1;
-    msg.rbuf = rbuf;
-    msg.len = sizeof(wbuf1);
-    msg.keepCs = 0;
-    msg.delayUs = 0;
 
-    ret = SpiTransfer(spiHandle, &msg, 1);
-    if (ret != 0) {
-        HDF_LOGE("SpiTransfer: failed, ret %d\n", ret);
+    if (op < W25X_OP_MAX) {
+        W25x_RecordLatency(dev, op, (uint32_t)(LOS_TickCountGet() - start) * W25x_MsPerSecond /
+            LOSCFG_BASE_CORE_TICK_PER_SECOND);
     }
 
-    return;
+    return HDF_SUCCESS;
 }
 
-
-void W25x_PowerDown(void)
+void W25x_WaitForWriteEnd(void)
 {
-    if (spiHandle == NULL) {
-        HDF_LOGE("spi flash haven't been inited\n");
+    W25xDev *dev = g_w25xDefaultDev;
+    if (!W25x_DevReady(dev)) {
         return;
     }
 
-    uint8_t wbuf[1] = {W25X_PowerDown};
-    uint8_t rbuf[1] = {0};
-    struct SpiMsg msg = {0};
-    msg.wbuf = wbuf;
-    msg.rbuf = rbuf;
-    msg.len = sizeof(wbuf);
-    msg.keepCs = 0;
-    msg.delayUs = 0;
-    int32_t ret = SpiTransfer(spiHandle, &msg, 1);
-    if (ret != 0) {
-        HDF_LOGE("SpiTransfer: failed, ret %d\n", ret);
+    (void)LOS_MuxPend(dev->opMux, LOS_WAIT_FOREVER);
+    (void)W25x_WaitForOpEnd(dev, W25X_OP_MAX);
+    (void)LOS_MuxPost(dev->opMux);
+}
+
+int32_t W25x_DevGetLatencyStat(W25xDev *dev, W25xOpType op, W25xLatencyStat *stat)
+{
+    if (dev == NULL || op >= W25X_OP_MAX || stat == NULL) {
+        return HDF_ERR_INVALID_PARAM;
     }
 
-    return;
+    return memcpy_s(stat, sizeof(*stat), &dev->latency[op], sizeof(dev->latency[op]));
 }
 
-void W25x_WAKEUP(void)
+int32_t W25x_GetLatencyStat(W25xOpType op, W25xLatencyStat *stat)
 {
-    if (spiHandle == NULL) {
-        HDF_LOGE("spi flash haven't been inited\n");
-        return;
+    return W25x_DevGetLatencyStat(g_w25xDefaultDev, op, stat);
+}
+
+void W25x_ResetLatencyStat(void)
+{
+    if (g_w25xDefaultDev != NULL) {
+        (void)memset_s(g_w25xDefaultDev->latency, sizeof(g_w25xDefaultDev->latency), 0,
+            sizeof(g_w25xDefaultDev->latency));
     }
+}
 
-    uint8_t wbuf[1] = {W25X_ReleasePowerDown};
-    uint8_t rbuf[1] = {0};
-    struct SpiMsg msg = {0};
-    msg.wbuf = wbuf;
-    msg.rbuf = rbuf;
-    msg.len = sizeof(wbuf);
-    msg.keepCs = 0;
-    msg.delayUs = 0;
-    int32_t ret = SpiTransfer(spiHandle, &msg, 1);
-    if (ret != 0) {
-        HDF_LOGE("SpiTransfer: failed, ret %d\n", ret);
+void W25x_DumpLatencyStat(void)
+{
+    static const char *opName[W25X_OP_MAX] = {"page program", "sector erase", "block erase", "chip erase"};
+    if (g_w25xDefaultDev == NULL) {
+        return;
     }
+    for (int op = 0; op < W25X_OP_MAX; op++) {
+        W25xLatencyStat *stat = &g_w25xDefaultDev->latency[op];
+        if (stat->count == 0) {
+            continue;
+        }
+        HDF_LOGI("%s: count %u, avg %u ms, max %u ms\n", opName[op], stat->count,
+            (uint32_t)(stat->totalMs / stat->count), stat->maxMs);
+        for (int i = 0; i < W25X_LAT_BUCKETS; i++) {
+            if (stat->buckets[i] == 0) {
+                continue;
+            }
+            if (i == W25X_LAT_BUCKETS - 1) {
+                HDF_LOGI("  >= %u ms: %u\n", 1U << (W25X_LAT_BUCKETS - 2), stat->buckets[i]);
+            } else {
+                HDF_LOGI("  < %u ms: %u\n", 1U << i, stat->buckets[i]);
+            }
+        }
+    }
+}
+
+int32_t W25x_DevPowerDown(W25xDev *dev)
+{
+    W25x_DrainAsync(dev);
+    return W25x_DevSendCmd(dev, W25X_PowerDown);
+}
 
-    return;
+int32_t W25x_DevWakeUp(W25xDev *dev)
+{
+    return W25x_DevSendCmd(dev, W25X_ReleasePowerDown);
+}
+
+void W25x_PowerDown(void)
+{
+    (void)W25x_DevPowerDown(g_w25xDefaultDev);
+}
+
+void W25x_WAKEUP(void)
+{
+    (void)W25x_DevWakeUp(g_w25xDefaultDev);
 }
 #endif
@@ -0,0 +1,64 @@
+/*
+ * Copyright (c) 2022 Talkweb Co., Ltd.
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef _BSP_BINLOG_H
+#define _BSP_BINLOG_H
+
+#include <stdarg.h>
+#include <stdint.h>
+
+/*
+ * Binary log frames, formatted on the host by tools/binlog_decode from the
+ * elf. A frame is the head below followed by count argument words, little
+ * endian like the target:
+ *   magic  BINLOG_MAGIC, never a byte of ascii text around the frames
+ *   info   level << 4 | count, level 0 for printf, hilog levels otherwise
+ *   module hilog module, 0 for printf
+ *   sum    all bytes of the frame add up to 0
+ *   time   ms since boot
+ *   fmt    address of the format string in the elf
+ * 64 bit and double arguments take two words, low word first. %s arguments
+ * are addresses too, the decoder reads the string from the elf.
+ */
+#define BINLOG_MAGIC        0xDB
+#define BINLOG_ARGS_MAX     15
+#define BINLOG_LEVEL_PRINTF 0
+#define BINLOG_HEAD_SIZE    12
+
+typedef struct {
+    uint8_t magic;
+    uint8_t info;
+    uint8_t module;
+    uint8_t sum;
+    uint32_t time;
+    uint32_t fmt;
+    uint32_t args[BINLOG_ARGS_MAX];
+} BinLogFrame;
+
+/*
+ * queue a frame of count words from args, one word per conversion like hilog
+ * passes them. Returns its size, or -1 if fmt or a %s string isn't in flash.
+ */
+int32_t BinLogWrite(uint8_t level, uint8_t module, uint32_t time, const char *fmt,
+    const void *args, uint32_t count);
+/*
+ * printf as a frame. Returns -1 and leaves ap alone when it has to be
+ * formatted on the target: fmt or a %s string outside flash, %n or %*,
+ * more than BINLOG_ARGS_MAX words, or interrupts off so the text is
+ * readable on a plain terminal after a crash. Returns the frame size.
+ */
+int32_t BinLogPrintf(const char *fmt, va_list ap);
+
+#endif
@@ -0,0 +1,36 @@
+/*
+ * Copyright (c) 2022 Talkweb Co., Ltd.
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef _BSP_CONSOLE_H
+#define _BSP_CONSOLE_H
+
+#include <stdint.h>
+
+/*
+ * Buffered console on usart1. Writers copy into a ring with interrupts off
+ * only for the copy, dma2 stream7 sends the ring in the background. With
+ * interrupts already off, e.g. from an exception, output is flushed and
+ * sent polled as before.
+ */
+void ConsoleInit(void);
+void ConsoleWrite(const char *s, uint32_t len);
+/* same without the "\r\n" translation, for binary data */
+void ConsoleWriteRaw(const void *data, uint32_t len);
+/* send everything buffered before returning, polled */
+void ConsoleFlush(void);
+/* messages dropped because the ring was full */
+uint32_t ConsoleDrops(void);
+
+#endif
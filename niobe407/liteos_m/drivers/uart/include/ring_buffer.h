@@ -0,0 +1,58 @@
+/*
+ * Copyright (c) 2022 Talkweb Co., Ltd.
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef _RING_BUFFER_H
+#define _RING_BUFFER_H
+
+#include <stdint.h>
+
+/*
+ * Single producer, single consumer ring, e.g. an uart isr writing and a task
+ * reading. No lock is needed: posW is only stored by the producer and posR
+ * only by the consumer, both run freely and wrap at 2^32, the size is a
+ * power of two so the index into buf is pos & mask.
+ */
+typedef struct {
+    uint32_t size;
+    uint32_t mask;
+    volatile uint32_t posW;
+    volatile uint32_t posR;
+    unsigned char *buf;
+} RingBuffer;
+
+/* size is rounded up to a power of two */
+RingBuffer* RingBufInit(int size);
+uint32_t RingBufUsed(const RingBuffer *buf);
+uint32_t RingBufFree(const RingBuffer *buf);
+
+/* one byte, 0 success while -1 empty or full */
+int RingBufRead(RingBuffer *buf, unsigned char *data);
+int RingBufWrite(RingBuffer *buf, unsigned char data);
+
+/* as much as fits or is there, returns the bytes moved */
+uint32_t RingBufReadMany(RingBuffer *buf, unsigned char *data, uint32_t size);
+uint32_t RingBufWriteMany(RingBuffer *buf, const unsigned char *data, uint32_t size);
+int RingBufWriteMore(RingBuffer *buf, unsigned char *data, uint32_t size);
+
+/*
+ * Zero copy access: peek returns the contiguous bytes readable (or writable)
+ * at *data, commit hands the first size of them over to the other side.
+ */
+uint32_t RingBufPeekRead(RingBuffer *buf, unsigned char **data);
+void RingBufCommitRead(RingBuffer *buf, uint32_t size);
+uint32_t RingBufPeekWrite(RingBuffer *buf, unsigned char **data);
+void RingBufCommitWrite(RingBuffer *buf, uint32_t size);
+
+#endif
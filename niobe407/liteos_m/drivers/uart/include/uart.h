@@ -19,20 +19,9 @@
 #include "los_event.h"
 #include "los_compiler.h"
 #include <stdio.h>
+#include "ring_buffer.h"
 
 #define CN_RCV_RING_BUFLEN  128
-typedef struct {
-    int size;
-    int posW;
-    int posR;
-    int dataLen;
-    unsigned char *buf;
-} RingBuffer;
-
-int RingBufRead(RingBuffer *buf, unsigned char *data);
-int RingBufWrite(RingBuffer *buf, unsigned char data);
-int RingBufWriteMore(RingBuffer *buf, unsigned char* data, uint32_t size);
-RingBuffer* RingBufInit(int size);
 
 extern UART_HandleTypeDef huart1;
 extern EVENT_CB_S g_shellInputEvent;
@@ -40,5 +29,7 @@ extern EVENT_CB_S g_shellInputEvent;
 extern VOID ShellUartInit(VOID);
 extern INT32 UartPutc(INT32 c, VOID *file);
 extern uint8_t UartGetc(VOID);
+/* bytes lost because the shell receive ring was full */
+extern uint32_t ShellUartRxDrops(VOID);
 
 #endif
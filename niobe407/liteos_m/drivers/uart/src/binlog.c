@@ -0,0 +1,177 @@
+/*
+ * Copyright (c) 2022 Talkweb Co., Ltd.
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "binlog.h"
+#include <string.h>
+#include "console.h"
+#include "los_config.h"
+#include "los_tick.h"
+#include "securec.h"
+#include "stm32f4xx_hal.h"
+
+#define BINLOG_LEVEL_SHIFT  4
+#define BINLOG_WORD_SIZE    4
+
+/* the decoder only has the elf, so only strings in flash can be left to it */
+static inline int BinLogInFlash(const char *s)
+{
+    return (uintptr_t)s >= FLASH_BASE && (uintptr_t)s <= FLASH_END;
+}
+
+static uint32_t BinLogNow(void)
+{
+    return (uint32_t)(LOS_TickCountGet() * 1000 / LOSCFG_BASE_CORE_TICK_PER_SECOND);
+}
+
+static int32_t BinLogSend(BinLogFrame *frame, uint8_t level, uint8_t module, uint32_t time,
+    const char *fmt, uint32_t count)
+{
+    const uint8_t *bytes = (const uint8_t *)frame;
+    uint32_t size = BINLOG_HEAD_SIZE + count * BINLOG_WORD_SIZE;
+    uint8_t sum = 0;
+
+    frame->magic = BINLOG_MAGIC;
+    frame->info = (uint8_t)((level << BINLOG_LEVEL_SHIFT) | count);
+    frame->module = module;
+    frame->sum = 0;
+    frame->time = time;
+    frame->fmt = (uint32_t)(uintptr_t)fmt;
+    for (uint32_t i = 0; i < size; i++) {
+        sum += bytes[i];
+    }
+    frame->sum = (uint8_t)(0 - sum);
+    ConsoleWriteRaw(frame, size);
+    return (int32_t)size;
+}
+
+/* the words of a %s in args must point into flash too, the decoder has nothing else */
+static int BinLogWordsInFlash(const char *fmt, const uint32_t *args, uint32_t count)
+{
+    const char *p = fmt;
+    uint32_t n = 0;
+
+    while ((p = strchr(p, '%')) != NULL && n < count) {
+        p++;
+        p += strspn(p, "-+ #0123456789.lhztjL");
+        if (*p == '%') {
+            p++;
+            continue;
+        }
+        if (*p == 's' && !BinLogInFlash((const char *)(uintptr_t)args[n])) {
+            return 0;
+        }
+        n++;
+    }
+    return 1;
+}
+
+int32_t BinLogWrite(uint8_t level, uint8_t module, uint32_t time, const char *fmt,
+    const void *args, uint32_t count)
+{
+    BinLogFrame frame;
+
+    if (!BinLogInFlash(fmt) || count > BINLOG_ARGS_MAX || !BinLogWordsInFlash(fmt, args, count)) {
+        return -1;
+    }
+    if (count > 0) {
+        (void)memcpy_s(frame.args, sizeof(frame.args), args, count * BINLOG_WORD_SIZE);
+    }
+    return BinLogSend(&frame, level, module, time, fmt, count);
+}
+
+/* words of one conversion, fmt points past the '%', -1 if it can't be left to the host */
+static int32_t BinLogArg(const char **fmt, va_list *ap, uint32_t *words, uint32_t room)
+{
+    const char *p = *fmt;
+    uint32_t longs = 0;
+    uint64_t wide;
+    double real;
+    const char *s = NULL;
+
+    p += strspn(p, "-+ #0");
+    p += strspn(p, "0123456789.");
+    while (*p == 'l' || *p == 'h' || *p == 'z' || *p == 't' || *p == 'j' || *p == 'L') {
+        longs += (*p == 'l') ? 1 : ((*p == 'j') ? 2 : 0);    // long is 32 bits, long long and intmax_t 64
+        p++;
+    }
+    *fmt = p + 1;
+    switch (*p) {
+        case '%':
+            return 0;
+        case 'd': case 'i': case 'u': case 'x': case 'X': case 'o': case 'c':
+            if (longs < 2) {
+                if (room < 1) {
+                    return -1;
+                }
+                words[0] = va_arg(*ap, uint32_t);
+                return 1;
+            }
+            if (room < 2) {
+                return -1;
+            }
+            wide = va_arg(*ap, uint64_t);
+            (void)memcpy_s(words, room * BINLOG_WORD_SIZE, &wide, sizeof(wide));
+            return 2;
+        case 'f': case 'F': case 'e': case 'E': case 'g': case 'G': case 'a': case 'A':
+            if (room < 2) {
+                return -1;
+            }
+            real = va_arg(*ap, double);     // long double is double on the m4
+            (void)memcpy_s(words, room * BINLOG_WORD_SIZE, &real, sizeof(real));
+            return 2;
+        case 'p':
+            if (room < 1) {
+                return -1;
+            }
+            words[0] = (uint32_t)(uintptr_t)va_arg(*ap, void *);
+            return 1;
+        case 's':
+            s = va_arg(*ap, const char *);
+            if (room < 1 || !BinLogInFlash(s)) {
+                return -1;
+            }
+            words[0] = (uint32_t)(uintptr_t)s;
+            return 1;
+        default:
+            return -1;  // %n, %* and anything unknown
+    }
+}
+
+int32_t BinLogPrintf(const char *fmt, va_list ap)
+{
+    BinLogFrame frame;
+    uint32_t count = 0;
+    int32_t ret = 0;
+    va_list args;
+    const char *p = fmt;
+
+    if (__get_PRIMASK() != 0 || !BinLogInFlash(fmt)) {
+        return -1;
+    }
+    va_copy(args, ap);
+    while ((p = strchr(p, '%')) != NULL) {
+        p++;
+        ret = BinLogArg(&p, &args, &frame.args[count], BINLOG_ARGS_MAX - count);
+        if (ret < 0) {
+            break;
+        }
+        count += (uint32_t)ret;
+    }
+    va_end(args);
+    if (ret < 0) {
+        return -1;
+    }
+    return BinLogSend(&frame, BINLOG_LEVEL_PRINTF, 0, BinLogNow(), fmt, count);
+}
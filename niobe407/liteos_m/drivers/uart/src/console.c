@@ -0,0 +1,232 @@
+/*
+ * Copyright (c) 2022 Talkweb Co., Ltd.
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "console.h"
+#include "los_config.h"
+#include "los_event.h"
+#include "los_interrupt.h"
+#include "stm32f4xx_hal.h"
+#include "uart.h"
+
+#define CONSOLE_RING_SIZE       LOSCFG_NIOBE407_CONSOLE_RING_SIZE
+#define CONSOLE_TX_DMA_STREAM   DMA2_Stream7    // usart1 tx, channel 4
+#define CONSOLE_TX_DMA_CHANNEL  (4U << DMA_SxCR_CHSEL_Pos)
+#define CONSOLE_TX_DMA_IRQ      DMA2_Stream7_IRQn
+#define CONSOLE_TX_DMA_FLAGS    (DMA_HIFCR_CFEIF7 | DMA_HIFCR_CDMEIF7 | DMA_HIFCR_CTEIF7 | \
+                                 DMA_HIFCR_CHTIF7 | DMA_HIFCR_CTCIF7)
+#define CONSOLE_TX_DMA_MAX      0xFFFF  // NDTR is 16 bits
+#define CONSOLE_ROOM_EVENT      0x1
+#define CONSOLE_BLOCK_TICKS     10
+#define CONSOLE_POLL_TIMEOUT    0xFFFF
+
+static RingBuffer *g_consoleRing = NULL;
+static volatile BOOL g_consoleTxBusy = FALSE;
+static uint32_t g_consoleTxLen = 0;     // bytes the running dma takes from the ring
+static uint32_t g_consoleDrops = 0;
+static EVENT_CB_S g_consoleEvent;
+
+static void ConsolePutcPolled(char ch)
+{
+    char cr = '\r';
+
+    if (ch == '\n') {
+        (void)HAL_UART_Transmit(&huart1, (uint8_t *)&cr, 1, CONSOLE_POLL_TIMEOUT);
+    }
+    (void)HAL_UART_Transmit(&huart1, (uint8_t *)&ch, 1, CONSOLE_POLL_TIMEOUT);
+}
+
+/* send the next contiguous part of the ring, called with interrupts off */
+static void ConsoleKick(void)
+{
+    unsigned char *data = NULL;
+    uint32_t len;
+
+    if (g_consoleTxBusy) {
+        return;
+    }
+    len = RingBufPeekRead(g_consoleRing, &data);
+    if (len == 0) {
+        return;
+    }
+    len = (len < CONSOLE_TX_DMA_MAX) ? len : CONSOLE_TX_DMA_MAX;
+    g_consoleTxLen = len;
+    g_consoleTxBusy = TRUE;
+    DMA2->HIFCR = CONSOLE_TX_DMA_FLAGS;
+    CONSOLE_TX_DMA_STREAM->M0AR = (uint32_t)data;
+    CONSOLE_TX_DMA_STREAM->NDTR = len;
+    SET_BIT(CONSOLE_TX_DMA_STREAM->CR, DMA_SxCR_EN);
+}
+
+static void ConsoleTxDmaIrq(void)
+{
+    DMA2->HIFCR = CONSOLE_TX_DMA_FLAGS;
+    if (!g_consoleTxBusy) {
+        return; // already finished by ConsoleFlush while interrupts were off
+    }
+    RingBufCommitRead(g_consoleRing, g_consoleTxLen);
+    g_consoleTxBusy = FALSE;
+    ConsoleKick();
+    (void)LOS_EventWrite(&g_consoleEvent, CONSOLE_ROOM_EVENT);
+}
+
+void ConsoleInit(void)
+{
+    if (g_consoleRing != NULL) {
+        return;
+    }
+    if (LOS_EventInit(&g_consoleEvent) != LOS_OK) {
+        return;
+    }
+    RingBuffer *ring = RingBufInit(CONSOLE_RING_SIZE);
+    if (ring == NULL) {
+        return;
+    }
+
+    __HAL_RCC_DMA2_CLK_ENABLE();
+    CLEAR_BIT(CONSOLE_TX_DMA_STREAM->CR, DMA_SxCR_EN);
+    while (READ_BIT(CONSOLE_TX_DMA_STREAM->CR, DMA_SxCR_EN) != 0) {
+    }
+    DMA2->HIFCR = CONSOLE_TX_DMA_FLAGS;
+    CONSOLE_TX_DMA_STREAM->PAR = (uint32_t)&huart1.Instance->DR;
+    CONSOLE_TX_DMA_STREAM->FCR = 0;
+    /* memory to peripheral, bytes, memory increment, one shot per ring part */
+    CONSOLE_TX_DMA_STREAM->CR = CONSOLE_TX_DMA_CHANNEL | DMA_SxCR_DIR_0 | DMA_SxCR_MINC |
+                                DMA_SxCR_TCIE | DMA_SxCR_TEIE;
+    LOS_HwiCreate(CONSOLE_TX_DMA_IRQ, 0, 1, (HWI_PROC_FUNC)ConsoleTxDmaIrq, 0);
+    SET_BIT(huart1.Instance->CR3, USART_CR3_DMAT);
+    g_consoleRing = ring;
+}
+
+/* finish the running dma and send the rest of the ring polled, interrupts must be off */
+static void ConsoleDrainPolled(void)
+{
+    unsigned char *data = NULL;
+    uint32_t len;
+
+    if (g_consoleTxBusy) {
+        while ((DMA2->HISR & (DMA_HISR_TCIF7 | DMA_HISR_TEIF7)) == 0 &&
+               READ_BIT(CONSOLE_TX_DMA_STREAM->CR, DMA_SxCR_EN) != 0) {
+        }
+        CLEAR_BIT(CONSOLE_TX_DMA_STREAM->CR, DMA_SxCR_EN);
+        DMA2->HIFCR = CONSOLE_TX_DMA_FLAGS;
+        RingBufCommitRead(g_consoleRing, g_consoleTxLen);
+        g_consoleTxBusy = FALSE;
+    }
+    while ((len = RingBufPeekRead(g_consoleRing, &data)) != 0) {
+        (void)HAL_UART_Transmit(&huart1, data, len, CONSOLE_POLL_TIMEOUT);
+        RingBufCommitRead(g_consoleRing, len);
+    }
+}
+
+void ConsoleFlush(void)
+{
+    UINT32 intSave;
+
+    if (g_consoleRing == NULL) {
+        return;
+    }
+    intSave = LOS_IntLock();
+    ConsoleDrainPolled();
+    LOS_IntRestore(intSave);
+}
+
+/* bytes the message takes in the ring, every '\n' goes out as "\r\n" */
+static uint32_t ConsoleSize(const char *s, uint32_t len)
+{
+    uint32_t size = len;
+
+    for (uint32_t i = 0; i < len; i++) {
+        size += (s[i] == '\n') ? 1 : 0;
+    }
+    return size;
+}
+
+static void ConsoleCopy(const char *s, uint32_t len)
+{
+    static const unsigned char crlf[] = {'\r', '\n'};
+    uint32_t start = 0;
+
+    for (uint32_t i = 0; i < len; i++) {
+        if (s[i] == '\n') {
+            (void)RingBufWriteMany(g_consoleRing, (const unsigned char *)s + start, i - start);
+            (void)RingBufWriteMany(g_consoleRing, crlf, sizeof(crlf));
+            start = i + 1;
+        }
+    }
+    (void)RingBufWriteMany(g_consoleRing, (const unsigned char *)s + start, len - start);
+}
+
+/* the whole message goes in the ring or none of it, raw data is copied as it is */
+static void ConsolePut(const char *s, uint32_t len, BOOL raw)
+{
+    UINT32 intSave;
+
+    if (g_consoleRing == NULL || __get_PRIMASK() != 0) {
+        /* before init, or the caller has interrupts off and the dma interrupt can't run */
+        if (g_consoleRing != NULL) {
+            ConsoleDrainPolled();
+        }
+        if (raw) {
+            (void)HAL_UART_Transmit(&huart1, (uint8_t *)s, len, CONSOLE_POLL_TIMEOUT);
+            return;
+        }
+        for (uint32_t i = 0; i < len; i++) {
+            ConsolePutcPolled(s[i]);
+        }
+        return;
+    }
+
+    uint32_t size = raw ? len : ConsoleSize(s, len);
+    while (1) {
+        intSave = LOS_IntLock();
+        if (RingBufFree(g_consoleRing) >= size) {
+            if (raw) {
+                (void)RingBufWriteMany(g_consoleRing, (const unsigned char *)s, len);
+            } else {
+                ConsoleCopy(s, len);
+            }
+            ConsoleKick();
+            LOS_IntRestore(intSave);
+            return;
+        }
+        LOS_IntRestore(intSave);
+#ifdef LOSCFG_NIOBE407_CONSOLE_OVERFLOW_BLOCK
+        if (size <= g_consoleRing->size && __get_IPSR() == 0) {
+            (void)LOS_EventRead(&g_consoleEvent, CONSOLE_ROOM_EVENT, LOS_WAITMODE_OR | LOS_WAITMODE_CLR,
+                CONSOLE_BLOCK_TICKS);
+            continue;
+        }
+#endif
+        intSave = LOS_IntLock();
+        g_consoleDrops++;
+        LOS_IntRestore(intSave);
+        return;
+    }
+}
+
+void ConsoleWrite(const char *s, uint32_t len)
+{
+    ConsolePut(s, len, FALSE);
+}
+
+void ConsoleWriteRaw(const void *data, uint32_t len)
+{
+    ConsolePut((const char *)data, len, TRUE);
+}
+
+uint32_t ConsoleDrops(void)
+{
+    return g_consoleDrops;
+}
@@ -0,0 +1,185 @@
+/*
+ * Copyright (c) 2022 Talkweb Co., Ltd.
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "ring_buffer.h"
+#include <stdlib.h>
+#include "securec.h"
+
+/*
+ * The data has to be in memory before the index that hands it over, and
+ * read out before the index that frees it. The M4 doesn't reorder normal
+ * memory accesses, so this mostly keeps the compiler from doing it.
+ */
+#if defined(__arm__)
+#define RING_BARRIER()  __asm__ volatile("dmb" ::: "memory")
+#else
+#define RING_BARRIER()  __atomic_thread_fence(__ATOMIC_ACQ_REL)
+#endif
+
+#define RING_SIZE_MAX   0x80000000U
+
+/**
+ * @brief: use this function to make a ringbuffer
+ * @input: size, rounded up to a power of two
+ * @return: the ring buffer maked, NULL failed while others success
+ */
+RingBuffer* RingBufInit(int size)
+{
+    RingBuffer *buf;
+    uint32_t ringSize = 1;
+
+    if (size <= 0 || (uint32_t)size > RING_SIZE_MAX) {
+        return NULL;
+    }
+    while (ringSize < (uint32_t)size) {
+        ringSize <<= 1;
+    }
+    buf = malloc(ringSize + sizeof(RingBuffer));
+    if (buf != NULL) {
+        buf->buf = (unsigned char*) buf + sizeof(RingBuffer);
+        buf->posR = 0;
+        buf->posW = 0;
+        buf->size = ringSize;
+        buf->mask = ringSize - 1;
+    }
+    return buf;
+}
+
+uint32_t RingBufUsed(const RingBuffer *buf)
+{
+    return buf->posW - buf->posR;
+}
+
+uint32_t RingBufFree(const RingBuffer *buf)
+{
+    return buf->size - (buf->posW - buf->posR);
+}
+
+/**
+ * @brief: use this function to read data from ring buffer
+ * @input: ringBuf, the ring buf to be read
+ * @input: data, data to be read storaged
+ * @return: 0 success while -1 failed
+ */
+int RingBufRead(RingBuffer *buf, unsigned char *data)
+{
+    uint32_t posR = buf->posR;
+
+    if (buf->posW == posR) {
+        return -1;
+    }
+    RING_BARRIER();
+    *data = buf->buf[posR & buf->mask];
+    RING_BARRIER();
+    buf->posR = posR + 1;
+    return 0;
+}
+
+/**
+ * @brief: use this function to write data to ring buffer
+ * @input: ringBuf, the ring buf to be read
+ * @input: data, data to be written
+ * @return: 0 success while -1 failed
+ */
+int RingBufWrite(RingBuffer *buf, unsigned char data)
+{
+    uint32_t posW = buf->posW;
+
+    if (posW - buf->posR == buf->size) {
+        return -1;
+    }
+    buf->buf[posW & buf->mask] = data;
+    RING_BARRIER();
+    buf->posW = posW + 1;
+    return 0;
+}
+
+uint32_t RingBufPeekRead(RingBuffer *buf, unsigned char **data)
+{
+    uint32_t posR = buf->posR;
+    uint32_t used = buf->posW - posR;
+    uint32_t toEnd = buf->size - (posR & buf->mask);
+
+    RING_BARRIER();
+    *data = &buf->buf[posR & buf->mask];
+    return (used < toEnd) ? used : toEnd;
+}
+
+void RingBufCommitRead(RingBuffer *buf, uint32_t size)
+{
+    RING_BARRIER();
+    buf->posR += size;
+}
+
+uint32_t RingBufPeekWrite(RingBuffer *buf, unsigned char **data)
+{
+    uint32_t posW = buf->posW;
+    uint32_t room = buf->size - (posW - buf->posR);
+    uint32_t toEnd = buf->size - (posW & buf->mask);
+
+    RING_BARRIER();
+    *data = &buf->buf[posW & buf->mask];
+    return (room < toEnd) ? room : toEnd;
+}
+
+void RingBufCommitWrite(RingBuffer *buf, uint32_t size)
+{
+    RING_BARRIER();
+    buf->posW += size;
+}
+
+/* at most two copies, up to the end of buf and from its start */
+uint32_t RingBufReadMany(RingBuffer *buf, unsigned char *data, uint32_t size)
+{
+    uint32_t done = 0;
+    unsigned char *src = NULL;
+
+    for (int part = 0; part < 2 && done < size; part++) {
+        uint32_t count = RingBufPeekRead(buf, &src);
+        if (count == 0) {
+            break;
+        }
+        count = (count < size - done) ? count : (size - done);
+        (void)memcpy_s(data + done, size - done, src, count);
+        RingBufCommitRead(buf, count);
+        done += count;
+    }
+    return done;
+}
+
+uint32_t RingBufWriteMany(RingBuffer *buf, const unsigned char *data, uint32_t size)
+{
+    uint32_t done = 0;
+    unsigned char *dst = NULL;
+
+    for (int part = 0; part < 2 && done < size; part++) {
+        uint32_t count = RingBufPeekWrite(buf, &dst);
+        if (count == 0) {
+            break;
+        }
+        count = (count < size - done) ? count : (size - done);
+        (void)memcpy_s(dst, count, data + done, count);
+        RingBufCommitWrite(buf, count);
+        done += count;
+    }
+    return done;
+}
+
+int RingBufWriteMore(RingBuffer *buf, unsigned char* data, uint32_t size)
+{
+    (void)RingBufWriteMany(buf, data, size);
+
+    return 0;
+}
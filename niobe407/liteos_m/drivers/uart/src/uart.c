@@ -32,6 +32,9 @@ DevHandle handle = NULL;
 #include "los_event.h"
 #include "stm32f4xx_hal_uart.h"
 #include "uart.h"
+#ifdef LOSCFG_NIOBE407_CONSOLE_DMA_TX
+#include "console.h"
+#endif
 
 #ifdef LOSCFG_DRIVERS_HDF_PLATFORM_UART
 INT32 UartPutc(INT32 ch, VOID *file)
@@ -49,6 +52,15 @@ INT32 UartPutc(INT32 ch, VOID *file)
         return UartWrite(handle, (uint8_t *)&ch, 1);
     }
 }
+#elif defined(LOSCFG_NIOBE407_CONSOLE_DMA_TX)
+INT32 UartPutc(INT32 ch, VOID *file)
+{
+    char c = (char)ch;
+
+    (void)file;
+    ConsoleWrite(&c, 1);
+    return 0;
+}
 #else
 INT32 UartPutc(INT32 ch, VOID *file)
 {
@@ -61,74 +73,17 @@ INT32 UartPutc(INT32 ch, VOID *file)
 }
 #endif
 
-#define CN_RCV_RING_BUFLEN  128
+#ifdef LOSCFG_NIOBE407_SHELL_UART_RING_SIZE
+#define SHELL_RING_BUFLEN   LOSCFG_NIOBE407_SHELL_UART_RING_SIZE
+#else
+#define SHELL_RING_BUFLEN   CN_RCV_RING_BUFLEN
+#endif
 static RingBuffer *g_debugRingBuf;
-/**
- * @brief: use this function to read data from ring buffer
- * @input: ringBuf, the ring buf to be read
- * @input: data, data to be read storaged
- * @return: 0 success while -1 failed
- */
-int RingBufRead(RingBuffer *buf, unsigned char *data)
-{
-    if (buf->dataLen == 0) {
-        return -1;
-    } else {
-        *data = buf->buf[buf->posR];
-        buf->posR = (buf->posR + 1) % buf->size;
-        buf->dataLen--;
-        return 0;
-    }
-}
-
-/**
- * @brief: use this function to write data to ring buffer
- * @input: ringBuf, the ring buf to be read
- * @input: data, data to be written
- * @return: 0 success while -1 failed
- */
-int RingBufWrite(RingBuffer *buf, unsigned char data)
-{
-    if (buf->dataLen == buf->size) {
-        return -1;
-    } else {
-        buf->buf[buf->posW] = data;
-        buf->posW = (buf->posW + 1) % buf->size;
-        buf->dataLen++;
-        return 0;
-    }
-}
+static uint32_t g_debugRxDrops = 0;
 
-int RingBufWriteMore(RingBuffer *buf, unsigned char* data, uint32_t size)
+uint32_t ShellUartRxDrops(void)
 {
-    for (uint32_t i = 0; i < size; i++) {
-        if (RingBufWrite(buf, data[i]) !=0) {
-            break;
-        }
-    }
-
-    return 0;
-}
-
-/**
- * @brief: use this function to make a ringbuffer
- * @return: the ring buffer maked, NULL failed while others success
- */
-RingBuffer* RingBufInit(int size)
-{
-    RingBuffer *buf;
-    if (size <= 0) {
-        return NULL;
-    }
-    buf = malloc(size + sizeof(RingBuffer));
-    if (buf != NULL) {
-        buf->buf = (unsigned char*) buf + sizeof(RingBuffer);
-        buf->dataLen = 0;
-        buf->posR = 0;
-        buf->posW = 0;
-        buf->size = size;
-    }
-    return buf;
+    return g_debugRxDrops;
 }
 
 uint8_t UartGetc(void)
@@ -160,10 +115,8 @@ static void HdfShellTaskEntry(void)
         if (readLen < 0) {
             return;
         } else {
-            for (int i = 0; i < readLen; i++) {
-                (void)RingBufWrite(g_debugRingBuf, rbuf[i]);
-                (void)LOS_EventWrite(&g_shellInputEvent, 0x1);
-            }
+            g_debugRxDrops += readLen - RingBufWriteMany(g_debugRingBuf, rbuf, readLen);
+            (void)LOS_EventWrite(&g_shellInputEvent, 0x1);
         }
     }
 
@@ -191,7 +144,7 @@ void StartUartShell(void)
 VOID ShellUartInit(VOID)
 {
     LosShellInit();
-    g_debugRingBuf = RingBufInit(CN_RCV_RING_BUFLEN);
+    g_debugRingBuf = RingBufInit(SHELL_RING_BUFLEN);
     if (g_debugRingBuf == NULL) {
         return;
     }
@@ -204,28 +157,117 @@ VOID ShellUartInit(VOID)
     StartUartShell();
 }
 #else
+#ifdef LOSCFG_NIOBE407_SHELL_UART_DMA_RX
+#define SHELL_RX_DMA_STREAM     DMA2_Stream5    // usart1 rx is channel 4 on dma2 stream2 or stream5, stream2 is spi1 rx
+#define SHELL_RX_DMA_CHANNEL    (4U << DMA_SxCR_CHSEL_Pos)
+#define SHELL_RX_DMA_IRQ        DMA2_Stream5_IRQn
+#define SHELL_RX_DMA_FLAGS      (DMA_HIFCR_CFEIF5 | DMA_HIFCR_CDMEIF5 | DMA_HIFCR_CTEIF5 | \
+                                 DMA_HIFCR_CHTIF5 | DMA_HIFCR_CTCIF5)
+#define SHELL_RX_DMA_BUF_SIZE   LOSCFG_NIOBE407_SHELL_UART_DMA_BUF_SIZE
+
+static uint8_t g_shellRxDma[SHELL_RX_DMA_BUF_SIZE]; // must stay out of ccmram, dma can't reach it
+static uint32_t g_shellRxPos = 0;   // first byte of g_shellRxDma not moved to the ring yet
+
+static void ShellRxPush(const uint8_t *data, uint32_t len)
+{
+    g_debugRxDrops += len - RingBufWriteMany(g_debugRingBuf, data, len);
+}
+
+/*
+ * Move what the dma wrote since the last call into the ring. Runs from the
+ * usart idle and the dma half/full interrupts, which share a priority so
+ * they never preempt each other.
+ */
+static void ShellRxDmaDrain(void)
+{
+    uint32_t pos = SHELL_RX_DMA_BUF_SIZE - SHELL_RX_DMA_STREAM->NDTR;
+
+    if (pos >= SHELL_RX_DMA_BUF_SIZE) {
+        pos = 0;
+    }
+    if (pos == g_shellRxPos) {
+        return;
+    }
+    if (pos > g_shellRxPos) {
+        ShellRxPush(&g_shellRxDma[g_shellRxPos], pos - g_shellRxPos);
+    } else {
+        ShellRxPush(&g_shellRxDma[g_shellRxPos], SHELL_RX_DMA_BUF_SIZE - g_shellRxPos);
+        ShellRxPush(g_shellRxDma, pos);
+    }
+    g_shellRxPos = pos;
+    (void)LOS_EventWrite(&g_shellInputEvent, 0x1);
+}
+
+static void ShellRxDmaStart(void)
+{
+    __HAL_RCC_DMA2_CLK_ENABLE();
+    CLEAR_BIT(SHELL_RX_DMA_STREAM->CR, DMA_SxCR_EN);
+    while (READ_BIT(SHELL_RX_DMA_STREAM->CR, DMA_SxCR_EN) != 0) {
+    }
+    DMA2->HIFCR = SHELL_RX_DMA_FLAGS;
+    SHELL_RX_DMA_STREAM->PAR = (uint32_t)&huart1.Instance->DR;
+    SHELL_RX_DMA_STREAM->M0AR = (uint32_t)g_shellRxDma;
+    SHELL_RX_DMA_STREAM->NDTR = SHELL_RX_DMA_BUF_SIZE;
+    SHELL_RX_DMA_STREAM->FCR = 0; // direct mode, every byte lands in memory right away
+    /* peripheral to memory, bytes, memory increment, circular */
+    SHELL_RX_DMA_STREAM->CR = SHELL_RX_DMA_CHANNEL | DMA_SxCR_MINC | DMA_SxCR_CIRC |
+                              DMA_SxCR_HTIE | DMA_SxCR_TCIE | DMA_SxCR_TEIE;
+    g_shellRxPos = 0;
+    SET_BIT(SHELL_RX_DMA_STREAM->CR, DMA_SxCR_EN);
+    SET_BIT(huart1.Instance->CR3, USART_CR3_DMAR);
+}
+
+static void ShellRxDmaIrq(void)
+{
+    uint32_t flags = DMA2->HISR;
+
+    DMA2->HIFCR = SHELL_RX_DMA_FLAGS;
+    ShellRxDmaDrain();
+    if ((flags & DMA_HISR_TEIF5) != 0) {
+        ShellRxDmaStart();  // a transfer error disables the stream
+    }
+}
+
+static void huart1_irq(void)
+{
+    if (__HAL_UART_GET_FLAG(&huart1, UART_FLAG_IDLE) != RESET) {
+        __HAL_UART_CLEAR_IDLEFLAG(&huart1);
+        ShellRxDmaDrain();
+    } else if (__HAL_UART_GET_FLAG(&huart1, UART_FLAG_ORE) != RESET) {
+        __HAL_UART_CLEAR_OREFLAG(&huart1);
+    }
+}
+#else
 static void huart1_irq(void)
 {
     if (__HAL_UART_GET_FLAG(&huart1, UART_FLAG_RXNE) != RESET) {
         unsigned char value;
         value = (uint8_t) (huart1.Instance->DR & 0x00FF);
-        RingBufWrite(g_debugRingBuf, value);
+        if (RingBufWrite(g_debugRingBuf, value) != 0) {
+            g_debugRxDrops++;
+        }
     } else if (__HAL_UART_GET_FLAG(&huart1, UART_FLAG_IDLE) != RESET) {
         __HAL_UART_CLEAR_IDLEFLAG(&huart1);
         (void)LOS_EventWrite(&g_shellInputEvent, 0x1);
     }
 }
+#endif
 
 VOID ShellUartInit(VOID)
 {
     LosShellInit();
-    g_debugRingBuf = RingBufInit(CN_RCV_RING_BUFLEN);
+    g_debugRingBuf = RingBufInit(SHELL_RING_BUFLEN);
     if (g_debugRingBuf == NULL) {
         printf("RingBufInit fail!\n");
         return;
     }
     LOS_HwiCreate(USART1_IRQn, 0, 1, (HWI_PROC_FUNC)huart1_irq, 0);
-    __HAL_UART_ENABLE_IT(&huart1, UART_IT_IDLE);
+#ifdef LOSCFG_NIOBE407_SHELL_UART_DMA_RX
+    LOS_HwiCreate(SHELL_RX_DMA_IRQ, 0, 1, (HWI_PROC_FUNC)ShellRxDmaIrq, 0);
+    ShellRxDmaStart();
+#else
     __HAL_UART_ENABLE_IT(&huart1, UART_IT_RXNE);
+#endif
+    __HAL_UART_ENABLE_IT(&huart1, UART_IT_IDLE);
 }
 #endif
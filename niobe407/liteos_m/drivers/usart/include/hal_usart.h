@@ -27,12 +27,28 @@ extern "C" {
 
 #if defined(USE_FULL_LL_DRIVER)
 
+/* receive counters of one port, since init or the last USART_ResetStat */
+typedef struct {
+    uint32_t rxBytes;       // bytes put in the ring
+    uint32_t ringOverflows; // bytes dropped because the ring was full
+    uint32_t ringPeak;      // most bytes waiting in the ring
+    uint32_t ringSize;      // rxBufSize of the port's uart_config node, rounded up to a power of two
+    uint32_t overruns;      // a byte came before the last one was read, the new one is lost
+    uint32_t framingErrors;
+    uint32_t parityErrors;
+    uint32_t noiseErrors;
+} UsartStat;
+
 uint32_t USART_TxData(USART_TypeDef * UART, uint8_t *p_data, uint32_t size);
 uint32_t USART_RxData(uint8_t num, uint8_t *p_data, uint32_t size, BOOL isBlock);
 
 void UART_IRQ_INIT(USART_TypeDef * UART, uint8_t num, uint32_t irqNum, BOOL isBlock);
 void UART_IRQ_DEINIT(USART_TypeDef * UART, uint32_t irqNum);
 
+/* LOS_NOK for a port that isn't set up, the "usartstat [reset]" shell command prints them all */
+uint32_t USART_GetStat(uint8_t num, UsartStat *stat);
+void USART_ResetStat(uint8_t num);
+
 #endif /* USE_FULL_LL_DRIVER */
 
 #endif /* USART1 || USART2 || USART3 || USART6 || UART4 || UART5 || UART7 || UART8 || UART9 || UART10 */
@@ -15,11 +15,26 @@
 
 #if defined(USE_FULL_LL_DRIVER)
 
+#include "hal_usart.h"
+#include <string.h>
 #include "stm32f4xx_ll_usart.h"
 #include "stm32f4xx_ll_rcc.h"
 #include "stm32f4xx_ll_bus.h"
 #include "uart.h"
+#include "los_interrupt.h"
 #include "los_task.h"
+#include "securec.h"
+#ifdef LOSCFG_SHELL
+#include "shcmd.h"
+#endif
+#ifdef LOSCFG_DRIVERS_HDF_PLATFORM_UART
+#ifdef LOSCFG_DRIVERS_HDF_CONFIG_MACRO
+#include "hcs_macro.h"
+#include "hdf_config_macro.h"
+#else
+#include "device_resource_if.h"
+#endif
+#endif
 
 #if defined (USART1) || defined (USART2) || defined (USART3) || \
     defined (UART4) || defined (UART5) || defined (USART6)
@@ -33,219 +48,165 @@
 #define UART_NUM5 5
 #define UART_NUM6 6
 
+#define USART_RING_SIZE_DEFAULT 128
+#define USART_RING_SIZE_MIN     16
+#define USART_RING_SIZE_MAX     32768
+#define USART_MATCH_ATTR_LEN    16
+#define USART_EVENT(num)        (1U << ((num) - 1))
+#define USART_RX_ERRORS         (USART_SR_ORE | USART_SR_FE | USART_SR_PE | USART_SR_NE)
+
+typedef struct {
+    USART_TypeDef *uart;
+    RingBuffer *ring;
+    BOOL isBlock;
+    UsartStat stat;
+} UsartPort;
+
 static EVENT_CB_S g_uartInputEvent;
 static BOOL g_eventInited = FALSE;
-static RingBuffer *g_uartRingBuf[UART_NUM_MAX] = {NULL};
-#define RING_BUFFER_SIZE 128
+static UsartPort g_usartPort[UART_NUM_MAX];
 
-typedef void (*UART_FUNC_CB)(void);
-static void USART1_IRQ_Func(void)
+static void UsartCountErrors(UsartStat *stat, uint32_t sr)
 {
-    if (LL_USART_IsActiveFlag_RXNE(USART1)) {
-        uint8_t value;
-        value = LL_USART_ReceiveData8(USART1);
-        LL_USART_ClearFlag_RXNE(USART1);
-        RingBufWrite(g_uartRingBuf[UART_NUM1], value);
-    }
-
-    return;
+    stat->overruns += ((sr & USART_SR_ORE) != 0) ? 1 : 0;
+    stat->framingErrors += ((sr & USART_SR_FE) != 0) ? 1 : 0;
+    stat->parityErrors += ((sr & USART_SR_PE) != 0) ? 1 : 0;
+    stat->noiseErrors += ((sr & USART_SR_NE) != 0) ? 1 : 0;
 }
 
-static void USART1_BLOCK_IRQ_Func(void)
+static void UsartRxIrq(uint8_t num)
 {
-    uint8_t value = 0;
-    if (LL_USART_IsActiveFlag_RXNE(USART1)) {
-        value = LL_USART_ReceiveData8(USART1);
-        LL_USART_ClearFlag_RXNE(USART1);
-        RingBufWrite(g_uartRingBuf[UART_NUM1 - 1], value);
+    UsartPort *port = &g_usartPort[num - 1];
+    USART_TypeDef *uart = port->uart;
+    uint32_t sr = LL_USART_ReadReg(uart, SR);
+
+    /* reading sr and then dr clears rxne, idle and the error flags */
+    if ((sr & (USART_SR_RXNE | USART_SR_ORE)) != 0) {
+        uint8_t value = LL_USART_ReceiveData8(uart);
+        if ((sr & USART_RX_ERRORS) != 0) {
+            UsartCountErrors(&port->stat, sr);
+        }
+        if (RingBufWrite(port->ring, value) != 0) {
+            port->stat.ringOverflows++;
+        } else {
+            uint32_t used = RingBufUsed(port->ring);
+            port->stat.rxBytes++;
+            port->stat.ringPeak = (used > port->stat.ringPeak) ? used : port->stat.ringPeak;
+        }
     }
 
-    if (LL_USART_IsActiveFlag_IDLE(USART1)) {
-        LL_USART_ClearFlag_IDLE(USART1);
-        if (LOS_EventWrite(&g_uartInputEvent, UART_NUM1) != 0) {
-            return;
+    if (port->isBlock && (sr & USART_SR_IDLE) != 0) {
+        if ((sr & USART_SR_RXNE) == 0) {
+            LL_USART_ClearFlag_IDLE(uart);
         }
+        (void)LOS_EventWrite(&g_uartInputEvent, USART_EVENT(num));
     }
 
     return;
 }
 
-static void USART2_IRQ_Func(void)
+typedef void (*UART_FUNC_CB)(void);
+static void USART1_IRQ_Func(void)
 {
-    if (LL_USART_IsActiveFlag_RXNE(USART2)) {
-        uint8_t value;
-        value = LL_USART_ReceiveData8(USART2);
-        LL_USART_ClearFlag_RXNE(USART2);
-        RingBufWrite(g_uartRingBuf[UART_NUM2 - 1], value);
-    }
-
-    return;
+    UsartRxIrq(UART_NUM1);
 }
 
-static void USART2_BLOCK_IRQ_Func(void)
+static void USART2_IRQ_Func(void)
 {
-    if (LL_USART_IsActiveFlag_RXNE(USART2)) {
-        uint8_t value;
-        value = LL_USART_ReceiveData8(USART2);
-        LL_USART_ClearFlag_RXNE(USART2);
-        RingBufWrite(g_uartRingBuf[UART_NUM2 - 1], value);
-    }
-
-    LL_USART_EnableIT_IDLE(USART2);
-    if (LL_USART_IsActiveFlag_IDLE(USART2)) {
-        LL_USART_DisableIT_IDLE(USART2);
-        if (LOS_EventWrite(&g_uartInputEvent, UART_NUM2) != 0) {
-            return;
-        }
-    }
-
-    return;
+    UsartRxIrq(UART_NUM2);
 }
 
 static void USART3_IRQ_Func(void)
 {
-    if (LL_USART_IsActiveFlag_RXNE(USART3)) {
-        uint8_t value;
-        value = LL_USART_ReceiveData8(USART3);
-        LL_USART_ClearFlag_RXNE(USART3);
-        RingBufWrite(g_uartRingBuf[UART_NUM3], value);
-    }
-
-    return;
+    UsartRxIrq(UART_NUM3);
 }
 
-static void USART3_BLOCK_IRQ_Func(void)
+static void USART4_IRQ_Func(void)
 {
-    if (LL_USART_IsActiveFlag_RXNE(USART3)) {
-        uint8_t value;
-        value = LL_USART_ReceiveData8(USART3);
-        LL_USART_ClearFlag_RXNE(USART3);
-        RingBufWrite(g_uartRingBuf[UART_NUM3 - 1], value);
-    }
-
-    LL_USART_EnableIT_IDLE(USART3);
-    if (LL_USART_IsActiveFlag_IDLE(USART3)) {
-        LL_USART_DisableIT_IDLE(USART3);
-        if (LOS_EventWrite(&g_uartInputEvent, UART_NUM3) != 0) {
-            return;
-        }
-    }
-
-    return;
+    UsartRxIrq(UART_NUM4);
 }
 
-static void USART4_IRQ_Func(void)
+static void USART5_IRQ_Func(void)
 {
-    if (LL_USART_IsActiveFlag_RXNE(UART4)) {
-        uint8_t value;
-        value = LL_USART_ReceiveData8(UART4);
-        LL_USART_ClearFlag_RXNE(UART4);
-        RingBufWrite(g_uartRingBuf[UART_NUM4], value);
-    }
-
-    return;
+    UsartRxIrq(UART_NUM5);
 }
 
-static void USART4_BLOCK_IRQ_Func(void)
+static void USART6_IRQ_Func(void)
 {
-    if (LL_USART_IsActiveFlag_RXNE(UART4)) {
-        uint8_t value;
-        value = LL_USART_ReceiveData8(UART4);
-        LL_USART_ClearFlag_RXNE(UART4);
-        RingBufWrite(g_uartRingBuf[UART_NUM4 - 1], value);
-    }
-
-    LL_USART_EnableIT_IDLE(UART4);
-    if (LL_USART_IsActiveFlag_IDLE(UART4)) {
-        LL_USART_DisableIT_IDLE(UART4);
-        if (LOS_EventWrite(&g_uartInputEvent, UART_NUM4) != 0) {
-            return;
-        }
-    }
-
-    return;
+    UsartRxIrq(UART_NUM6);
 }
 
-static void USART5_IRQ_Func(void)
+static UART_FUNC_CB g_funcMap[UART_NUM_MAX] = {
+    USART1_IRQ_Func,
+    USART2_IRQ_Func,
+    USART3_IRQ_Func,
+    USART4_IRQ_Func,
+    USART5_IRQ_Func,
+    USART6_IRQ_Func,
+};
+
+/* rxBufSize of the uart_config node with this num, the default without one */
+#if defined(LOSCFG_DRIVERS_HDF_PLATFORM_UART) && defined(LOSCFG_DRIVERS_HDF_CONFIG_MACRO)
+#define PLATFORM_UART_CONFIG HCS_NODE(HCS_NODE(HCS_ROOT, platform), uart_config)
+#define USART_FIND_RING_SIZE(node, port, size) \
+    do { \
+        if (HCS_PROP(node, num) == (port)) { \
+            (size) = HCS_PROP(node, rxBufSize); \
+        } \
+    } while (0);
+
+static uint32_t UsartRingSize(uint8_t num)
 {
-    if (LL_USART_IsActiveFlag_RXNE(UART5)) {
-        uint8_t value;
-        value = LL_USART_ReceiveData8(UART5);
-        LL_USART_ClearFlag_RXNE(UART5);
-        RingBufWrite(g_uartRingBuf[UART_NUM5], value);
-    }
+    uint32_t size = USART_RING_SIZE_DEFAULT;
 
-    return;
+    HCS_FOREACH_CHILD_VARGS(PLATFORM_UART_CONFIG, USART_FIND_RING_SIZE, num, size);
+    return size;
 }
-
-static void USART5_BLOCK_IRQ_Func(void)
+#elif defined(LOSCFG_DRIVERS_HDF_PLATFORM_UART)
+static uint32_t UsartRingSize(uint8_t num)
 {
-    if (LL_USART_IsActiveFlag_RXNE(UART5)) {
-        uint8_t value;
-        value = LL_USART_ReceiveData8(UART5);
-        LL_USART_ClearFlag_RXNE(UART5);
-        RingBufWrite(g_uartRingBuf[UART_NUM5 - 1], value);
-    }
+    char matchAttr[USART_MATCH_ATTR_LEN];
+    uint32_t size = USART_RING_SIZE_DEFAULT;
+    struct DeviceResourceIface *resource = DeviceResourceGetIfaceInstance(HDF_CONFIG_SOURCE);
 
-    LL_USART_EnableIT_IDLE(UART5);
-    if (LL_USART_IsActiveFlag_IDLE(UART5)) {
-        LL_USART_DisableIT_IDLE(UART5);
-        if (LOS_EventWrite(&g_uartInputEvent, UART_NUM5) != 0) {
-            return;
-        }
+    if (resource == NULL ||
+        snprintf_s(matchAttr, sizeof(matchAttr), sizeof(matchAttr) - 1, "uart_config%u", num) < 0) {
+        return size;
     }
-
-    return;
+    const struct DeviceResourceNode *node = resource->GetNodeByMatchAttr(matchAttr);
+    if (node != NULL) {
+        (void)resource->GetUint32(node, "rxBufSize", &size, USART_RING_SIZE_DEFAULT);
+    }
+    return size;
 }
-
-static void USART6_IRQ_Func(void)
+#else
+static uint32_t UsartRingSize(uint8_t num)
 {
-    if (LL_USART_IsActiveFlag_RXNE(USART6)) {
-        uint8_t value;
-        value = LL_USART_ReceiveData8(USART6);
-        RingBufWrite(g_uartRingBuf[UART_NUM6], value);
-    }
-
-    return;
+    (void)num;
+    return USART_RING_SIZE_DEFAULT;
 }
+#endif
 
-static void USART6_BLOCK_IRQ_Func(void)
+#ifdef LOSCFG_SHELL
+static UINT32 UsartShellCmd(UINT32 argc, const CHAR **argv)
 {
-    if (LL_USART_IsActiveFlag_RXNE(USART6)) {
-        uint8_t value;
-        value = LL_USART_ReceiveData8(USART6);
-        LL_USART_ClearFlag_RXNE(USART6);
-        RingBufWrite(g_uartRingBuf[UART_NUM6 - 1], value);
-    }
+    BOOL reset = (argc > 0 && strcmp(argv[0], "reset") == 0);
+    UsartStat stat;
 
-    LL_USART_EnableIT_IDLE(USART6);
-    if (LL_USART_IsActiveFlag_IDLE(USART6)) {
-        LL_USART_DisableIT_IDLE(USART6);
-        if (LOS_EventWrite(&g_uartInputEvent, UART_NUM6) != 0) {
-            return;
+    printf("port ring peak rx_bytes overflows overruns framing parity noise\n");
+    for (uint8_t num = 1; num <= UART_NUM_MAX; num++) {
+        if (USART_GetStat(num, &stat) != LOS_OK) {
+            continue;
+        }
+        printf("%4u %4u %4u %8u %9u %8u %7u %6u %5u\n", num, stat.ringSize, stat.ringPeak, stat.rxBytes,
+            stat.ringOverflows, stat.overruns, stat.framingErrors, stat.parityErrors, stat.noiseErrors);
+        if (reset) {
+            USART_ResetStat(num);
         }
     }
-
-    return;
+    return LOS_OK;
 }
-
-static UART_FUNC_CB g_funcMap[UART_NUM_MAX] = {
-    USART1_IRQ_Func,
-    USART2_IRQ_Func,
-    USART3_IRQ_Func,
-    USART4_IRQ_Func,
-    USART5_IRQ_Func,
-    USART6_IRQ_Func,
-};
-
-static UART_FUNC_CB g_funcBlockMap[UART_NUM_MAX] = {
-    USART1_BLOCK_IRQ_Func,
-    USART2_BLOCK_IRQ_Func,
-    USART3_BLOCK_IRQ_Func,
-    USART4_BLOCK_IRQ_Func,
-    USART5_BLOCK_IRQ_Func,
-    USART6_BLOCK_IRQ_Func,
-};
+#endif
 
 uint32_t USART_TxData(USART_TypeDef * UART, uint8_t *p_data, uint32_t size)
 {
@@ -261,29 +222,50 @@ uint32_t USART_TxData(USART_TypeDef * UART, uint8_t *p_data, uint32_t size)
 
 void UART_IRQ_INIT(USART_TypeDef * UART, uint8_t num, uint32_t irqNum, BOOL isBlock)
 {
-    g_uartRingBuf[num - 1] = RingBufInit(RING_BUFFER_SIZE);
-    if (g_uartRingBuf[num - 1] == NULL) {
-        printf("RingBufInit fail!\n");
+    if (num < UART_NUM1 || num > UART_NUM_MAX) {
+        printf("UART_IRQ_INIT invalid num %u!\n", num);
         return;
     }
-    if (isBlock) {
-        if (!g_eventInited) {
-            int32_t ret = LOS_EventInit(&g_uartInputEvent);
-            if (ret != LOS_OK) {
-                printf("Init uartInputEvent failed! ERROR: 0x%x\n", ret);
-                return ret;
-            } else {
-                g_eventInited = TRUE;
-            }
+    UsartPort *port = &g_usartPort[num - 1];
+
+    /* the ring stays when the port is set up again, e.g. for a new baudrate */
+    if (port->ring == NULL) {
+        uint32_t size = UsartRingSize(num);
+        if (size < USART_RING_SIZE_MIN || size > USART_RING_SIZE_MAX) {
+            printf("uart%u rxBufSize %u out of %u..%u, using %u\n", num, size,
+                USART_RING_SIZE_MIN, USART_RING_SIZE_MAX, USART_RING_SIZE_DEFAULT);
+            size = USART_RING_SIZE_DEFAULT;
+        }
+        port->ring = RingBufInit(size);
+        if (port->ring == NULL) {
+            printf("RingBufInit fail!\n");
+            return;
+        }
+        port->stat.ringSize = port->ring->size;
+#ifdef LOSCFG_SHELL
+        static BOOL cmdRegistered = FALSE;
+        if (!cmdRegistered) {
+            (void)osCmdReg(CMD_TYPE_EX, "usartstat", 0, (CmdCallBackFunc)UsartShellCmd);
+            cmdRegistered = TRUE;
+        }
+#endif
+    }
+    if (isBlock && !g_eventInited) {
+        uint32_t ret = LOS_EventInit(&g_uartInputEvent);
+        if (ret != LOS_OK) {
+            printf("Init uartInputEvent failed! ERROR: 0x%x\n", ret);
+            return;
         }
+        g_eventInited = TRUE;
+    }
+    port->uart = UART;
+    port->isBlock = isBlock;
 
-        LL_USART_EnableIT_RXNE(UART);
+    LL_USART_EnableIT_RXNE(UART);
+    if (isBlock) {
         LL_USART_EnableIT_IDLE(UART);
-        ArchHwiCreate(irqNum, UART_IRQ_NUM, 1, g_funcBlockMap[num - 1], NULL);
-    } else {
-        LL_USART_EnableIT_RXNE(UART);
-        ArchHwiCreate(irqNum, UART_IRQ_NUM, 1, g_funcMap[num - 1], NULL);
     }
+    ArchHwiCreate(irqNum, UART_IRQ_NUM, 1, g_funcMap[num - 1], NULL);
 
     return;
 }
@@ -291,6 +273,7 @@ void UART_IRQ_INIT(USART_TypeDef * UART, uint8_t num, uint32_t irqNum, BOOL isBl
 void UART_IRQ_DEINIT(USART_TypeDef * UART, uint32_t irqNum)
 {
     LL_USART_DisableIT_RXNE(UART);
+    LL_USART_DisableIT_IDLE(UART);
     ArchHwiDelete(irqNum, NULL);
 
     return;
@@ -298,24 +281,44 @@ void UART_IRQ_DEINIT(USART_TypeDef * UART, uint32_t irqNum)
 
 uint32_t USART_RxData(uint8_t num, uint8_t *p_data, uint32_t size, BOOL isBlock)
 {
-    uint32_t readLen = 0;
-    unsigned char data;
+    if (num < UART_NUM1 || num > UART_NUM_MAX || g_usartPort[num - 1].ring == NULL) {
+        return 0;
+    }
     if (isBlock) {
-        (VOID)LOS_EventRead(&g_uartInputEvent, num, LOS_WAITMODE_AND | LOS_WAITMODE_CLR, LOS_WAIT_FOREVER);
+        (VOID)LOS_EventRead(&g_uartInputEvent, USART_EVENT(num), LOS_WAITMODE_AND | LOS_WAITMODE_CLR,
+            LOS_WAIT_FOREVER);
     }
 
-    while (size--) {
-        if (RingBufRead(g_uartRingBuf[num - 1], &data) == 0) {
-            *p_data = data;
-            readLen++;
-            p_data++;
-        } else {
-            break;
-        }
+    return RingBufReadMany(g_usartPort[num - 1].ring, p_data, size);
+}
+
+uint32_t USART_GetStat(uint8_t num, UsartStat *stat)
+{
+    UINT32 intSave;
+
+    if (num < UART_NUM1 || num > UART_NUM_MAX || stat == NULL || g_usartPort[num - 1].ring == NULL) {
+        return LOS_NOK;
     }
+    intSave = LOS_IntLock();
+    *stat = g_usartPort[num - 1].stat;
+    LOS_IntRestore(intSave);
+    return LOS_OK;
+}
 
-    return readLen;
+void USART_ResetStat(uint8_t num)
+{
+    UINT32 intSave;
+
+    if (num < UART_NUM1 || num > UART_NUM_MAX) {
+        return;
+    }
+    UsartStat *stat = &g_usartPort[num - 1].stat;
+    intSave = LOS_IntLock();
+    uint32_t ringSize = stat->ringSize;
+    (void)memset_s(stat, sizeof(*stat), 0, sizeof(*stat));
+    stat->ringSize = ringSize;
+    LOS_IntRestore(intSave);
 }
 #endif /* USART1 || USART2 || USART3 || USART6 || UART4 || UART5 */
 
-#endif /* USE_FULL_LL_DRIVER */
+#endif /* USE_FULL_LL_DRIVER */
\ No newline at end of file
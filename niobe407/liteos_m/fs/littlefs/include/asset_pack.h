@@ -0,0 +1,78 @@
+/*
+ * Copyright (c) 2022 Talkweb Co., Ltd.
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef _ASSET_PACK_H_
+#define _ASSET_PACK_H_
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Read-only asset pack on the external flash, written by tools/asset_pack:
+ * an AssetPackHeader, the AssetPackEntry index sorted by name, then the
+ * asset data. Offsets are from the start of the pack, crcs are lfs_crc
+ * seeded with 0xFFFFFFFF. All fields are little endian.
+ */
+#define ASSET_PACK_MAGIC        0x4B505341 // "ASPK"
+#define ASSET_PACK_VERSION      1
+#define ASSET_NAME_MAX          48         // including the terminating 0
+#define ASSET_DATA_ALIGN        256        // assets start on a flash page
+
+typedef struct {
+    uint32_t magic;
+    uint16_t version;
+    uint16_t count;     // index entries
+    uint32_t size;      // whole pack, header to the end of the last asset
+    uint32_t indexCrc;  // over the index entries
+    uint32_t crc;       // over the header up to here
+} AssetPackHeader;
+
+typedef struct {
+    char name[ASSET_NAME_MAX];
+    uint32_t offset;
+    uint32_t size;
+    uint32_t crc;       // over the asset data
+    uint32_t reserved;
+} AssetPackEntry;
+
+typedef struct {
+    uint32_t addr;      // flash address of the data
+    uint32_t size;
+    uint32_t crc;
+} AssetHandle;
+
+/* return non HDF_SUCCESS to stop AssetStream early, that value is passed back */
+typedef int32_t (*AssetChunkFunc)(const uint8_t *chunk, uint32_t size, void *arg);
+
+/*
+ * The STM32F407 can't map the spi flash into its address space, so assets
+ * are read with the driver straight into the caller's buffer instead: no
+ * littlefs metadata walk and no heap copy of the whole asset.
+ */
+int32_t AssetPackInit(void);
+uint32_t AssetPackCount(void);
+int32_t AssetOpen(const char *name, AssetHandle *asset);
+int32_t AssetRead(const AssetHandle *asset, uint32_t offset, uint8_t *buf, uint32_t size);
+int32_t AssetStream(const AssetHandle *asset, uint8_t *chunk, uint32_t chunkSize, AssetChunkFunc func, void *arg);
+int32_t AssetVerify(const AssetHandle *asset);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _ASSET_PACK_H_ */
@@ -0,0 +1,51 @@
+/*
+ * Copyright (c) 2022 Talkweb Co., Ltd.
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef _LITTLEFS_CACHE_H_
+#define _LITTLEFS_CACHE_H_
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct {
+    uint32_t hits;          // lines found in the cache
+    uint32_t misses;        // lines read from flash on demand
+    uint32_t readAheads;    // lines read from flash past a sequential miss
+    uint32_t bypasses;      // reads of a line or more sent to flash directly
+    uint32_t invalidates;   // lines dropped by prog or erase
+    uint32_t warmLines;     // lines kept over the last warm reset
+} LittlefsCacheStat;
+
+/*
+ * Read cache of the external flash shared by all littlefs mounts. Addresses
+ * are absolute flash addresses. Lines only hold what is on flash, prog and
+ * erase go through the cache so it never serves stale data.
+ */
+int32_t LittlefsCacheInit(void);
+int32_t LittlefsCacheRead(uint32_t addr, uint8_t *buf, uint32_t size);
+int32_t LittlefsCacheProg(uint32_t addr, const uint8_t *buf, uint32_t size);
+int32_t LittlefsCacheErase(uint32_t addr, uint32_t size);
+void LittlefsCacheGetStat(LittlefsCacheStat *stat);
+void LittlefsCacheResetStat(void);
+void LittlefsCacheDumpStat(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _LITTLEFS_CACHE_H_ */
@@ -0,0 +1,39 @@
+/*
+ * Copyright (c) 2022 Talkweb Co., Ltd.
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef _LITTLEFS_MOUNT_H_
+#define _LITTLEFS_MOUNT_H_
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * The littlefs partitions from hcs are mounted by the fs driver at hdf init,
+ * in background tasks with NIOBE407_LITTLEFS_ASYNC_MOUNT. Call this before
+ * the first file access. A mountPoint of NULL waits for every partition, a
+ * timeoutMs of LOS_WAIT_FOREVER waits until the mount finished. Returns
+ * HDF_SUCCESS once mounted, HDF_ERR_TIMEOUT if still mounting, else
+ * HDF_FAILURE.
+ */
+int32_t LittlefsMountWait(const char *mountPoint, uint32_t timeoutMs);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _LITTLEFS_MOUNT_H_ */
@@ -0,0 +1,45 @@
+/*
+ * Copyright (c) 2022 Talkweb Co., Ltd.
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef _LITTLEFS_REMAP_H_
+#define _LITTLEFS_REMAP_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Bad block remapping per littlefs partition. Attach takes spare blocks and
+ * two table blocks off the end of the partition and loads the table kept
+ * there. A block retired after a failed erase is served from a spare from
+ * then on. A block that fails a prog is only marked pending: littlefs still
+ * reads it to move the data away, so it is retired on its next erase.
+ * Partitions are identified by their flash base address.
+ */
+int32_t LittlefsRemapAttach(uint32_t base, uint32_t blockSize, uint32_t *blockCount);
+uint32_t LittlefsRemapAddr(uint32_t base, uint32_t blockSize, uint32_t block);
+int32_t LittlefsRemapRetire(uint32_t base, uint32_t block);
+void LittlefsRemapMarkPending(uint32_t base, uint32_t block);
+bool LittlefsRemapTakePending(uint32_t base, uint32_t block);
+uint32_t LittlefsRemapCount(uint32_t base);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _LITTLEFS_REMAP_H_ */
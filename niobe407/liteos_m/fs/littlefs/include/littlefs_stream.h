@@ -0,0 +1,59 @@
+/*
+ * Copyright (c) 2022 Talkweb Co., Ltd.
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef _LITTLEFS_STREAM_H_
+#define _LITTLEFS_STREAM_H_
+
+#include <stdint.h>
+#ifdef LOSCFG_NET_LWIP
+#include "lwip/pbuf.h"
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define LITTLEFS_STREAM_BUF_SIZE    LOSCFG_NIOBE407_LITTLEFS_STREAM_BUF_SIZE
+
+typedef struct LittlefsStream LittlefsStream;
+
+/*
+ * Large file transfers through the littlefs mounts. Buffers come from a
+ * fixed pool and are handed over, not copied: a submitted buffer belongs to
+ * the stream task until it is written, a buffer returned by read belongs to
+ * the caller until LittlefsStreamBufPut. File io runs in the stream task, so
+ * the network side and the flash side overlap.
+ */
+int32_t LittlefsStreamInit(void);
+uint8_t *LittlefsStreamBufGet(uint32_t timeoutMs);
+void LittlefsStreamBufPut(uint8_t *buf);
+
+/* oflags as for open, O_RDONLY streams read ahead, anything else streams writes */
+LittlefsStream *LittlefsStreamOpen(const char *path, int oflags);
+int32_t LittlefsStreamSubmit(LittlefsStream *stream, uint8_t *buf, uint32_t len);
+#ifdef LOSCFG_NET_LWIP
+/* the chain is written as it is and freed by the stream task */
+int32_t LittlefsStreamSubmitPbuf(LittlefsStream *stream, struct pbuf *p);
+#endif
+/* next chunk in *buf, returns its length, 0 at the end of the file or a negative error */
+int32_t LittlefsStreamRead(LittlefsStream *stream, uint8_t **buf, uint32_t timeoutMs);
+/* waits for the queued writes, returns the first error of the stream */
+int32_t LittlefsStreamClose(LittlefsStream *stream);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _LITTLEFS_STREAM_H_ */
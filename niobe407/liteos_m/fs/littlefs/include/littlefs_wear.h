@@ -0,0 +1,55 @@
+/*
+ * Copyright (c) 2022 Talkweb Co., Ltd.
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef _LITTLEFS_WEAR_H_
+#define _LITTLEFS_WEAR_H_
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define LITTLEFS_WEAR_BUCKETS       8   // 0, 1, 2-3, 4-7, ... 32-63, 64 and more erases
+#define LITTLEFS_WEAR_HOT_BLOCKS    5
+#define LITTLEFS_WEAR_NO_ESTIMATE   0xFFFFFFFF
+
+typedef struct {
+    uint32_t blocks;
+    uint32_t totalErases;
+    uint32_t minErases;
+    uint32_t maxErases;
+    uint32_t histogram[LITTLEFS_WEAR_BUCKETS];      // blocks per erase count bucket
+    uint32_t hotBlock[LITTLEFS_WEAR_HOT_BLOCKS];    // most erased blocks first
+    uint32_t hotErases[LITTLEFS_WEAR_HOT_BLOCKS];
+    uint32_t seconds;       // since counting started
+    uint32_t lifetimeDays;  // until the hottest block reaches the rated cycles at the rate seen so far
+} LittlefsWearStat;
+
+/*
+ * Erase counters per littlefs block, counted in RAM from boot. Blocks are
+ * the block numbers littlefs uses, partitions are told apart by their base
+ * address. The "lfswear" shell command prints the report of every partition.
+ */
+int32_t LittlefsWearAttach(const char *mountPoint, uint32_t base, uint32_t blockCount);
+void LittlefsWearRecord(uint32_t base, uint32_t block);
+int32_t LittlefsWearGetStat(const char *mountPoint, LittlefsWearStat *stat);
+void LittlefsWearDump(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _LITTLEFS_WEAR_H_ */
@@ -0,0 +1,61 @@
+/*
+ * Copyright (c) 2022 Talkweb Co., Ltd.
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef _LITTLEFS_WRITEBACK_H_
+#define _LITTLEFS_WRITEBACK_H_
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef enum {
+    LITTLEFS_WB_FLUSH_SYNC = 0, // lfs sync or LittlefsWriteBackFlush
+    LITTLEFS_WB_FLUSH_FULL,     // a staged page was filled
+    LITTLEFS_WB_FLUSH_EVICT,    // all slots staged, the oldest had to go
+    LITTLEFS_WB_FLUSH_TIMER,    // staged data older than the flush interval
+    LITTLEFS_WB_FLUSH_HOOK,     // LittlefsWriteBackFlushFromIsr, e.g. low voltage
+    LITTLEFS_WB_FLUSH_MAX,
+} LittlefsWbFlushReason;
+
+typedef struct {
+    uint32_t progs;                             // lfs prog calls staged
+    uint32_t pagePrograms;                      // pages sent to flash
+    uint32_t flushErrors;                       // page programs that failed, the page stays staged
+    uint32_t flushes[LITTLEFS_WB_FLUSH_MAX];    // page programs by reason
+} LittlefsWbStat;
+
+/*
+ * Stage lfs prog calls in page sized slots and program each page once,
+ * when it fills up, on sync, after the flush interval or from the low
+ * voltage hook. Staged bytes are ANDed into reads like the flash would.
+ * A page that fails to program stays staged, and the next
+ * LittlefsWriteBackFlush returns HDF_FAILURE even if the retry goes through.
+ */
+int32_t LittlefsWriteBackInit(void);
+int32_t LittlefsWriteBackRead(uint32_t addr, uint8_t *buf, uint32_t size);
+int32_t LittlefsWriteBackProg(uint32_t addr, const uint8_t *buf, uint32_t size);
+int32_t LittlefsWriteBackErase(uint32_t addr, uint32_t size);
+int32_t LittlefsWriteBackFlush(void);
+void LittlefsWriteBackFlushFromIsr(void);
+void LittlefsWriteBackGetStat(LittlefsWbStat *stat);
+void LittlefsWriteBackDumpStat(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _LITTLEFS_WRITEBACK_H_ */
@@ -0,0 +1,165 @@
+/*
+ * Copyright (c) 2022 Talkweb Co., Ltd.
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "asset_pack.h"
+#include <stdbool.h>
+#include <stddef.h>
+#include <string.h>
+#include "w25qxx.h"
+#include "hdf_log.h"
+#include "lfs_util.h"
+#include "securec.h"
+
+#define ASSET_PACK_ADDR     LOSCFG_NIOBE407_ASSET_PACK_ADDR
+#define ASSET_PACK_SIZE     LOSCFG_NIOBE407_ASSET_PACK_SIZE
+#define ASSET_CRC_CHUNK     64 // stack buffer for the crc walks
+
+static AssetPackHeader g_assetHeader;
+static bool g_assetInited = false;
+
+static int32_t AssetFlashRead(uint32_t offset, uint8_t *buf, uint32_t size)
+{
+    return W25x_DevRead(W25x_GetDefaultDev(), buf, ASSET_PACK_ADDR + offset, size);
+}
+
+static int32_t AssetCrc(uint32_t offset, uint32_t size, uint32_t *crc)
+{
+    uint8_t chunk[ASSET_CRC_CHUNK];
+
+    *crc = 0xFFFFFFFF;
+    while (size > 0) {
+        uint32_t once = (size < sizeof(chunk)) ? size : sizeof(chunk);
+        if (AssetFlashRead(offset, chunk, once) != HDF_SUCCESS) {
+            return HDF_FAILURE;
+        }
+        *crc = lfs_crc(*crc, chunk, once);
+        offset += once;
+        size -= once;
+    }
+    return HDF_SUCCESS;
+}
+
+/* check header and index once, the data crcs are left to AssetVerify */
+int32_t AssetPackInit(void)
+{
+    AssetPackHeader header;
+    uint32_t crc;
+
+    if (g_assetInited) {
+        return HDF_SUCCESS;
+    }
+    if (AssetFlashRead(0, (uint8_t *)&header, sizeof(header)) != HDF_SUCCESS) {
+        return HDF_FAILURE;
+    }
+    if (header.magic != ASSET_PACK_MAGIC || header.version != ASSET_PACK_VERSION ||
+        header.crc != lfs_crc(0xFFFFFFFF, &header, offsetof(AssetPackHeader, crc)) ||
+        header.size > ASSET_PACK_SIZE ||
+        sizeof(header) + header.count * sizeof(AssetPackEntry) > header.size) {
+        HDF_LOGE("%s: no asset pack at 0x%x\n", __func__, ASSET_PACK_ADDR);
+        return HDF_FAILURE;
+    }
+    if (AssetCrc(sizeof(header), header.count * sizeof(AssetPackEntry), &crc) != HDF_SUCCESS ||
+        crc != header.indexCrc) {
+        HDF_LOGE("%s: asset pack index at 0x%x corrupted\n", __func__, ASSET_PACK_ADDR);
+        return HDF_FAILURE;
+    }
+    (void)memcpy_s(&g_assetHeader, sizeof(g_assetHeader), &header, sizeof(header));
+    g_assetInited = true;
+    HDF_LOGI("%s: %u assets, %u KB at 0x%x\n", __func__, header.count, header.size / 1024, ASSET_PACK_ADDR);
+
+    return HDF_SUCCESS;
+}
+
+uint32_t AssetPackCount(void)
+{
+    return g_assetInited ? g_assetHeader.count : 0;
+}
+
+/* binary search over the index on flash, one entry read per step */
+int32_t AssetOpen(const char *name, AssetHandle *asset)
+{
+    AssetPackEntry entry;
+    int32_t low = 0;
+    int32_t high;
+
+    if (!g_assetInited || name == NULL || asset == NULL) {
+        return HDF_FAILURE;
+    }
+    high = (int32_t)g_assetHeader.count - 1;
+    while (low <= high) {
+        int32_t mid = low + (high - low) / 2;
+        if (AssetFlashRead(sizeof(AssetPackHeader) + mid * sizeof(entry), (uint8_t *)&entry,
+            sizeof(entry)) != HDF_SUCCESS) {
+            return HDF_FAILURE;
+        }
+        entry.name[ASSET_NAME_MAX - 1] = '\0';
+        int cmp = strcmp(name, entry.name);
+        if (cmp == 0) {
+            if (entry.offset > g_assetHeader.size || entry.size > g_assetHeader.size - entry.offset) {
+                return HDF_FAILURE;
+            }
+            asset->addr = ASSET_PACK_ADDR + entry.offset;
+            asset->size = entry.size;
+            asset->crc = entry.crc;
+            return HDF_SUCCESS;
+        }
+        if (cmp < 0) {
+            high = mid - 1;
+        } else {
+            low = mid + 1;
+        }
+    }
+    return HDF_FAILURE;
+}
+
+int32_t AssetRead(const AssetHandle *asset, uint32_t offset, uint8_t *buf, uint32_t size)
+{
+    if (asset == NULL || buf == NULL || offset > asset->size || size > asset->size - offset) {
+        return HDF_ERR_INVALID_PARAM;
+    }
+    if (size == 0) {
+        return HDF_SUCCESS;
+    }
+    return W25x_DevRead(W25x_GetDefaultDev(), buf, asset->addr + offset, size);
+}
+
+/* walk the whole asset through the caller's chunk buffer, which may be a dma buffer */
+int32_t AssetStream(const AssetHandle *asset, uint8_t *chunk, uint32_t chunkSize, AssetChunkFunc func, void *arg)
+{
+    if (asset == NULL || chunk == NULL || chunkSize == 0 || func == NULL) {
+        return HDF_ERR_INVALID_PARAM;
+    }
+    for (uint32_t offset = 0; offset < asset->size; offset += chunkSize) {
+        uint32_t once = (asset->size - offset < chunkSize) ? (asset->size - offset) : chunkSize;
+        int32_t ret = AssetRead(asset, offset, chunk, once);
+        if (ret == HDF_SUCCESS) {
+            ret = func(chunk, once, arg);
+        }
+        if (ret != HDF_SUCCESS) {
+            return ret;
+        }
+    }
+    return HDF_SUCCESS;
+}
+
+int32_t AssetVerify(const AssetHandle *asset)
+{
+    uint32_t crc;
+
+    if (asset == NULL || AssetCrc(asset->addr - ASSET_PACK_ADDR, asset->size, &crc) != HDF_SUCCESS) {
+        return HDF_FAILURE;
+    }
+    return (crc == asset->crc) ? HDF_SUCCESS : HDF_FAILURE;
+}
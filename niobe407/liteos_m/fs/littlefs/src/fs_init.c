@@ -15,7 +15,29 @@
 
 #include <sys/mount.h>
 #include "littlefs.h"
+#include "littlefs_mount.h"
+#include "w25qxx.h"
+#ifdef LOSCFG_NIOBE407_LITTLEFS_CACHE
+#include "littlefs_cache.h"
+#endif
+#ifdef LOSCFG_NIOBE407_LITTLEFS_WRITE_BACK
+#include "littlefs_writeback.h"
+#endif
+#ifdef LOSCFG_NIOBE407_LITTLEFS_REMAP
+#include "littlefs_remap.h"
+#endif
+#ifdef LOSCFG_NIOBE407_ASSET_PACK
+#include "asset_pack.h"
+#endif
+#ifdef LOSCFG_NIOBE407_LITTLEFS_STREAM
+#include "littlefs_stream.h"
+#endif
+#ifdef LOSCFG_NIOBE407_LITTLEFS_WEAR_STATS
+#include "littlefs_wear.h"
+#endif
 #include "los_config.h"
+#include "los_event.h"
+#include "los_task.h"
 #include "hdf_log.h"
 #include "hdf_device_desc.h"
 #ifdef LOSCFG_DRIVERS_HDF_CONFIG_MACRO
@@ -26,24 +48,97 @@
 #endif
 #include <sys/stat.h>
 #include <dirent.h>
+#include <string.h>
 
 #define LITTLEFS_PHYS_ADDR 0x800000
 
 #define READ_SIZE      64
 #define PROG_SIZE      64
-#define BLOCK_SIZE     4096
-#define BLOCK_COUNT    2048
 #define CACHE_SIZE     64
 #define LOOKAHEAD_SIZE 64
 #define BLOCK_CYCLES   16
 #define ERASE_FLASH_BULK 0
 
+#define FS_MOUNT_EVENT(i)       (1U << (i))
+#define FS_MOUNT_STACK_SIZE     0x1000
+#define FS_MOUNT_TASK_NAME      "lfs_mount"
+#define FS_MOUNT_TASK_PRIORITY  20
+
 struct fs_cfg {
     char *mount_point;
     struct lfs_config lfs_cfg;
 };
 
 static struct fs_cfg fs[LOSCFG_LFS_MAX_MOUNT_SIZE] = {0};
+static EVENT_CB_S g_fsMountEvent;
+static volatile UINT32 g_fsMountFailed = 0;
+static BOOL g_fsMountStarted = FALSE;
+
+/* erase only the partition, with 64KB/32KB blocks where aligned, through the cache so no old line survives */
+static int32_t FsResetPartition(struct fs_cfg *cfg)
+{
+    uint32_t size = cfg->lfs_cfg.block_size * cfg->lfs_cfg.block_count;
+#ifdef LOSCFG_NIOBE407_LITTLEFS_CACHE
+    int32_t ret = LittlefsCacheErase((uint32_t)cfg->lfs_cfg.context, size);
+#else
+    int32_t ret = W25x_EraseRange((uint32_t)cfg->lfs_cfg.context, size);
+#endif
+    HDF_LOGI("%s: erase '%s' 0x%x + 0x%x %s\n", __func__, cfg->mount_point,
+             (uint32_t)cfg->lfs_cfg.context, size, (ret == HDF_SUCCESS) ? "succeed" : "failed");
+    return ret;
+}
+
+/*
+ * Fit the partition to the chip found at init. A block_size of 0 takes the
+ * smallest erase unit, a block_count of 0 the rest of the chip.
+ */
+static int32_t FsFitPartition(struct fs_cfg *cfg, const W25xFlashInfo *info)
+{
+    uint32_t start = (uint32_t)cfg->lfs_cfg.context;
+    uint32_t eraseSize = info->eraseSize[0];
+
+    if (cfg->lfs_cfg.block_size == 0) {
+        cfg->lfs_cfg.block_size = eraseSize;
+    }
+    if ((cfg->lfs_cfg.block_size % eraseSize) != 0 || (start % eraseSize) != 0 || start >= info->capacity) {
+        HDF_LOGE("%s: '%s' at 0x%x with block_size %u does not fit a %u KB flash erased in %u bytes\n",
+                 __func__, cfg->mount_point, start, cfg->lfs_cfg.block_size, info->capacity / 1024, eraseSize);
+        return HDF_FAILURE;
+    }
+
+    uint32_t maxCount = (info->capacity - start) / cfg->lfs_cfg.block_size;
+    if (cfg->lfs_cfg.block_count > maxCount) {
+        HDF_LOGE("%s: '%s' cut to %u blocks at the end of flash\n", __func__, cfg->mount_point, maxCount);
+        cfg->lfs_cfg.block_count = maxCount;
+    } else if (cfg->lfs_cfg.block_count == 0) {
+        cfg->lfs_cfg.block_count = maxCount;
+    }
+    return HDF_SUCCESS;
+}
+
+/* fill the tuning left at 0 in hcs, and fall back to the defaults if lfs would reject the mix */
+static void FsFitTuning(struct fs_cfg *cfg)
+{
+    struct lfs_config *c = &cfg->lfs_cfg;
+
+    c->read_size = (c->read_size != 0) ? c->read_size : READ_SIZE;
+    c->prog_size = (c->prog_size != 0) ? c->prog_size : PROG_SIZE;
+    c->cache_size = (c->cache_size != 0) ? c->cache_size : CACHE_SIZE;
+    c->lookahead_size = (c->lookahead_size != 0) ? c->lookahead_size : LOOKAHEAD_SIZE;
+    c->block_cycles = (c->block_cycles != 0) ? c->block_cycles : BLOCK_CYCLES;
+
+    if ((c->cache_size % c->read_size) != 0 || (c->cache_size % c->prog_size) != 0 ||
+        (c->block_size % c->cache_size) != 0 || (c->lookahead_size % 8) != 0) {
+        HDF_LOGE("%s: '%s' read %u prog %u cache %u lookahead %u don't fit block %u, use defaults\n",
+                 __func__, cfg->mount_point, c->read_size, c->prog_size, c->cache_size, c->lookahead_size,
+                 c->block_size);
+        c->read_size = READ_SIZE;
+        c->prog_size = PROG_SIZE;
+        c->cache_size = CACHE_SIZE;
+        c->lookahead_size = LOOKAHEAD_SIZE;
+    }
+}
+
 #ifdef LOSCFG_DRIVERS_HDF_CONFIG_MACRO
 #define DISPLAY_MISC_FS_LITTLEFS_CONFIG HCS_NODE(HCS_NODE(HCS_NODE(HCS_ROOT, misc), fs_config), littlefs_config)
 static uint32_t FsGetResource(struct fs_cfg *fs)
@@ -57,11 +152,21 @@ static uint32_t FsGetResource(struct fs_cfg *fs)
     uint32_t partitions[] = HCS_ARRAYS(HCS_NODE(DISPLAY_MISC_FS_LITTLEFS_CONFIG, partitions));
     uint32_t block_size[] = HCS_ARRAYS(HCS_NODE(DISPLAY_MISC_FS_LITTLEFS_CONFIG, block_size));
     uint32_t block_count[] = HCS_ARRAYS(HCS_NODE(DISPLAY_MISC_FS_LITTLEFS_CONFIG, block_count));
+    uint32_t read_size[] = HCS_ARRAYS(HCS_NODE(DISPLAY_MISC_FS_LITTLEFS_CONFIG, read_size));
+    uint32_t prog_size[] = HCS_ARRAYS(HCS_NODE(DISPLAY_MISC_FS_LITTLEFS_CONFIG, prog_size));
+    uint32_t cache_size[] = HCS_ARRAYS(HCS_NODE(DISPLAY_MISC_FS_LITTLEFS_CONFIG, cache_size));
+    uint32_t lookahead_size[] = HCS_ARRAYS(HCS_NODE(DISPLAY_MISC_FS_LITTLEFS_CONFIG, lookahead_size));
+    uint32_t block_cycles[] = HCS_ARRAYS(HCS_NODE(DISPLAY_MISC_FS_LITTLEFS_CONFIG, block_cycles));
     for (int32_t i = 0; i < num; i++) {
         fs[i].mount_point = mount_points[i];
         fs[i].lfs_cfg.context = partitions[i];
         fs[i].lfs_cfg.block_size = block_size[i];
         fs[i].lfs_cfg.block_count = block_count[i];
+        fs[i].lfs_cfg.read_size = read_size[i];
+        fs[i].lfs_cfg.prog_size = prog_size[i];
+        fs[i].lfs_cfg.cache_size = cache_size[i];
+        fs[i].lfs_cfg.lookahead_size = lookahead_size[i];
+        fs[i].lfs_cfg.block_cycles = (int32_t)block_cycles[i];
 
         HDF_LOGI("%s: fs[%d] mount_point=%s, partition=%u, block_size=%u, block_count=%u",
                  __func__, i, fs[i].mount_point, (uint32_t)fs[i].lfs_cfg.context,
@@ -70,6 +175,20 @@ static uint32_t FsGetResource(struct fs_cfg *fs)
     return HDF_SUCCESS;
 }
 #else
+/* tuning arrays are optional, a missing or short one leaves 0 for the defaults */
+static void FsGetTuning(struct DeviceResourceIface *resource, const struct DeviceResourceNode *resourceNode,
+    int32_t i, struct lfs_config *cfg)
+{
+    uint32_t block_cycles = 0;
+
+    (void)resource->GetUint32ArrayElem(resourceNode, "read_size", i, &cfg->read_size, 0);
+    (void)resource->GetUint32ArrayElem(resourceNode, "prog_size", i, &cfg->prog_size, 0);
+    (void)resource->GetUint32ArrayElem(resourceNode, "cache_size", i, &cfg->cache_size, 0);
+    (void)resource->GetUint32ArrayElem(resourceNode, "lookahead_size", i, &cfg->lookahead_size, 0);
+    (void)resource->GetUint32ArrayElem(resourceNode, "block_cycles", i, &block_cycles, 0);
+    cfg->block_cycles = (int32_t)block_cycles;
+}
+
 static uint32_t FsGetResource(struct fs_cfg *fs, const struct DeviceResourceNode *resourceNode)
 {
     struct DeviceResourceIface *resource = DeviceResourceGetIfaceInstance(HDF_CONFIG_SOURCE);
@@ -103,6 +222,7 @@ static uint32_t FsGetResource(struct fs_cfg *fs, const struct DeviceResourceNode
             HDF_LOGE("%s: failed to get block_count", __func__);
             return HDF_FAILURE;
         }
+        FsGetTuning(resource, resourceNode, i, &fs[i].lfs_cfg);
         HDF_LOGI("%s: fs[%d] mount_point=%s, partition=%u, block_size=%u, block_count=%u",
                  __func__, i,fs[i].mount_point, (uint32_t)fs[i].lfs_cfg.context,
                  fs[i].lfs_cfg.block_size, fs[i].lfs_cfg.block_count);
@@ -135,51 +255,175 @@ static int32_t FsDriverCheck(struct HdfDeviceObject *object)
         return HDF_FAILURE;
     }
 
+    W25xFlashInfo info;
+    if (W25x_GetFlashInfo(&info) != HDF_SUCCESS) {
+        return HDF_FAILURE;
+    }
+    for (int i = 0; i < sizeof(fs) / sizeof(fs[0]); i++) {
+        if (fs[i].mount_point == NULL) {
+            continue;
+        }
+        if (FsFitPartition(&fs[i], &info) != HDF_SUCCESS) {
+            fs[i].mount_point = NULL;
+            continue;
+        }
+        FsFitTuning(&fs[i]);
+#ifdef LOSCFG_NIOBE407_LITTLEFS_REMAP
+        if (LittlefsRemapAttach((uint32_t)fs[i].lfs_cfg.context, fs[i].lfs_cfg.block_size,
+            &fs[i].lfs_cfg.block_count) != HDF_SUCCESS) {
+            HDF_LOGE("%s: '%s' without bad block remap\n", __func__, fs[i].mount_point);
+        }
+#endif
+#ifdef LOSCFG_NIOBE407_LITTLEFS_WEAR_STATS
+        (void)LittlefsWearAttach(fs[i].mount_point, (uint32_t)fs[i].lfs_cfg.context, fs[i].lfs_cfg.block_count);
+#endif
+        HDF_LOGI("%s: '%s' read %u prog %u cache %u lookahead %u block_cycles %d\n", __func__,
+                 fs[i].mount_point, fs[i].lfs_cfg.read_size, fs[i].lfs_cfg.prog_size, fs[i].lfs_cfg.cache_size,
+                 fs[i].lfs_cfg.lookahead_size, fs[i].lfs_cfg.block_cycles);
+    }
+#ifdef LOSCFG_NIOBE407_LITTLEFS_CACHE
+    if (LittlefsCacheInit() != HDF_SUCCESS) {
+        HDF_LOGE("%s: littlefs cache off\n", __func__);
+    }
+#endif
+#ifdef LOSCFG_NIOBE407_LITTLEFS_WRITE_BACK
+    if (LittlefsWriteBackInit() != HDF_SUCCESS) {
+        HDF_LOGE("%s: littlefs write-back off\n", __func__);
+    }
+#endif
+#ifdef LOSCFG_NIOBE407_LITTLEFS_STREAM
+    if (LittlefsStreamInit() != HDF_SUCCESS) {
+        HDF_LOGE("%s: littlefs stream off\n", __func__);
+    }
+#endif
+#ifdef LOSCFG_NIOBE407_ASSET_PACK
+    (void)AssetPackInit();
+#endif
+
 #if (ERASE_FLASH_BULK == 1)
-    W25x_BulkErase();
+    for (int i = 0; i < sizeof(fs) / sizeof(fs[0]); i++) {
+        if (fs[i].mount_point != NULL) {
+            (void)FsResetPartition(&fs[i]);
+        }
+    }
 #endif
     return HDF_SUCCESS;
 }
 
+static void FsMountDone(int i, BOOL mounted)
+{
+    if (!mounted) {
+        g_fsMountFailed |= FS_MOUNT_EVENT(i);
+    }
+    (void)LOS_EventWrite(&g_fsMountEvent, FS_MOUNT_EVENT(i));
+}
+
+/* lfs formats a partition it can't mount, so a fresh or corrupted one takes a full format here */
+static void FsMountOne(int i)
+{
+    DIR *dir = NULL;
+
+    int ret = mount(NULL, fs[i].mount_point, "littlefs", 0, &fs[i].lfs_cfg);
+    BOOL mounted = (ret == 0);
+    HDF_LOGI("%s: mount fs on '%s' %s\n", __func__, fs[i].mount_point, mounted ? "succeed" : "failed");
+    if ((dir = opendir(fs[i].mount_point)) == NULL) {
+        HDF_LOGI("first time create file %s\n", fs[i].mount_point);
+        ret = mkdir(fs[i].mount_point, S_IRUSR | S_IWUSR);
+        if (ret != LOS_OK) {
+            HDF_LOGE("Mkdir failed %d\n", ret);
+            FsMountDone(i, FALSE);
+            return;
+        } else {
+            HDF_LOGI("mkdir success %d\n", ret);
+        }
+    } else {
+        HDF_LOGI("open dir success!\n");
+        closedir(dir);
+    }
+    FsMountDone(i, mounted);
+}
+
+#ifdef LOSCFG_NIOBE407_LITTLEFS_ASYNC_MOUNT
+static void FsMountEntry(UINT32 i)
+{
+    FsMountOne((int)i);
+}
+
+/* one task per partition, the spi bus lock interleaves them so a long format doesn't hold up the others */
+static void FsMountAsync(int i)
+{
+    UINT32 taskID;
+    TSK_INIT_PARAM_S stTask = {0};
+
+    stTask.pfnTaskEntry = (TSK_ENTRY_FUNC)FsMountEntry;
+    stTask.uwStackSize = FS_MOUNT_STACK_SIZE;
+    stTask.pcName = FS_MOUNT_TASK_NAME;
+    stTask.usTaskPrio = FS_MOUNT_TASK_PRIORITY;
+    stTask.uwArg = (UINT32)i;
+    if (LOS_TaskCreate(&taskID, &stTask) != LOS_OK) {
+        HDF_LOGE("%s: mount task for '%s' not created, mount inline\n", __func__, fs[i].mount_point);
+        FsMountOne(i);
+    }
+}
+#endif
+
 static int32_t FsDriverInit(struct HdfDeviceObject *object)
 {
-    if (HDF_SUCCESS != FsDriverCheck(object))
+    if (LOS_EventInit(&g_fsMountEvent) != LOS_OK) {
         return HDF_FAILURE;
+    }
+    g_fsMountStarted = TRUE;
+    if (HDF_SUCCESS != FsDriverCheck(object)) {
+        for (int i = 0; i < sizeof(fs) / sizeof(fs[0]); i++) {
+            FsMountDone(i, FALSE);
+        }
+        return HDF_FAILURE;
+    }
 
-    DIR *dir = NULL;
     for (int i = 0; i < sizeof(fs) / sizeof(fs[0]); i++) {
-        if (fs[i].mount_point == NULL)
+        if (fs[i].mount_point == NULL) {
+            FsMountDone(i, FALSE);
             continue;
+        }
 
         fs[i].lfs_cfg.read = LittlefsRead;
         fs[i].lfs_cfg.prog = LittlefsProg;
         fs[i].lfs_cfg.erase = LittlefsErase;
         fs[i].lfs_cfg.sync = LittlefsSync;
-        fs[i].lfs_cfg.read_size = READ_SIZE;
-        fs[i].lfs_cfg.prog_size = PROG_SIZE;
-        fs[i].lfs_cfg.cache_size = CACHE_SIZE;
-        fs[i].lfs_cfg.lookahead_size = LOOKAHEAD_SIZE;
-        fs[i].lfs_cfg.block_cycles = BLOCK_CYCLES;
-
-        int ret = mount(NULL, fs[i].mount_point, "littlefs", 0, &fs[i].lfs_cfg);
-        HDF_LOGI("%s: mount fs on '%s' %s\n", __func__, fs[i].mount_point, (ret == 0) ? "succeed" : "failed");
-        if ((dir = opendir(fs[i].mount_point)) == NULL) {
-            HDF_LOGI("first time create file %s\n", fs[i].mount_point);
-            ret = mkdir(fs[i].mount_point, S_IRUSR | S_IWUSR);
-            if (ret != LOS_OK) {
-                HDF_LOGE("Mkdir failed %d\n", ret);
-                return;
-            } else {
-                HDF_LOGI("mkdir success %d\n", ret);
-            }
-        } else {
-            HDF_LOGI("open dir success!\n");
-            closedir(dir);
-        }
+
+#ifdef LOSCFG_NIOBE407_LITTLEFS_ASYNC_MOUNT
+        FsMountAsync(i);
+#else
+        FsMountOne(i);
+#endif
     }
     return HDF_SUCCESS;
 }
 
+int32_t LittlefsMountWait(const char *mountPoint, uint32_t timeoutMs)
+{
+    UINT32 mask = 0;
+
+    if (!g_fsMountStarted) {
+        return HDF_FAILURE;
+    }
+    for (int i = 0; i < sizeof(fs) / sizeof(fs[0]); i++) {
+        if (fs[i].mount_point != NULL && (mountPoint == NULL || strcmp(fs[i].mount_point, mountPoint) == 0)) {
+            mask |= FS_MOUNT_EVENT(i);
+        }
+    }
+    if (mask == 0) {
+        return HDF_FAILURE;
+    }
+    UINT32 ticks = (timeoutMs == LOS_WAIT_FOREVER) ? LOS_WAIT_FOREVER : LOS_MS2Tick(timeoutMs);
+    /* the return value mixes bits and error codes, the event itself tells what has finished */
+    (void)LOS_EventRead(&g_fsMountEvent, mask, LOS_WAITMODE_AND, ticks);
+    if ((g_fsMountEvent.uwEventID & mask) != mask) {
+        return HDF_ERR_TIMEOUT;
+    }
+    return ((g_fsMountFailed & mask) == 0) ? HDF_SUCCESS : HDF_FAILURE;
+}
+
 static int32_t FsDriverBind(struct HdfDeviceObject *device)
 {
     (void)device;
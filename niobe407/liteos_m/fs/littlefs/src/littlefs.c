@@ -13,31 +13,181 @@
  * limitations under the License.
  */
 #include "littlefs.h"
+#include "w25qxx.h"
+#ifdef LOSCFG_NIOBE407_LITTLEFS_CACHE
+#include "littlefs_cache.h"
+#endif
+#ifdef LOSCFG_NIOBE407_LITTLEFS_WRITE_BACK
+#include "littlefs_writeback.h"
+#endif
+#ifdef LOSCFG_NIOBE407_LITTLEFS_REMAP
+#include "littlefs_remap.h"
+#endif
+#ifdef LOSCFG_NIOBE407_LITTLEFS_WEAR_STATS
+#include "littlefs_wear.h"
+#endif
 #include <stdio.h>
 #include <string.h>
 #include "los_memory.h"
 
+#define VERIFY_CHUNK 64 // read-back buffer on the caller's stack
+#define BD_RETRIES   2  // a second try rides out a transient bus fault before a block is given up
+
+/* the layers below the callbacks, all taking absolute flash addresses */
+static int32_t BdRead(uint32_t addr, uint8_t *buf, uint32_t size)
+{
+#if defined(LOSCFG_NIOBE407_LITTLEFS_WRITE_BACK)
+    return LittlefsWriteBackRead(addr, buf, size);
+#elif defined(LOSCFG_NIOBE407_LITTLEFS_CACHE)
+    return LittlefsCacheRead(addr, buf, size);
+#else
+    return W25x_DevRead(W25x_GetDefaultDev(), buf, addr, size);
+#endif
+}
+
+static int32_t BdProg(uint32_t addr, const uint8_t *buf, uint32_t size)
+{
+#if defined(LOSCFG_NIOBE407_LITTLEFS_WRITE_BACK)
+    return LittlefsWriteBackProg(addr, buf, size);
+#elif defined(LOSCFG_NIOBE407_LITTLEFS_CACHE)
+    return LittlefsCacheProg(addr, buf, size);
+#else
+    return W25x_DevWrite(W25x_GetDefaultDev(), buf, addr, size);
+#endif
+}
+
+static int32_t BdErase(uint32_t addr, uint32_t size)
+{
+#if defined(LOSCFG_NIOBE407_LITTLEFS_WRITE_BACK)
+    return LittlefsWriteBackErase(addr, size);
+#elif defined(LOSCFG_NIOBE407_LITTLEFS_CACHE)
+    return LittlefsCacheErase(addr, size);
+#else
+    return W25x_DevEraseRange(W25x_GetDefaultDev(), addr, size);
+#endif
+}
+
+static uint32_t BdBlockAddr(const struct lfs_config *cfg, lfs_block_t block)
+{
+#ifdef LOSCFG_NIOBE407_LITTLEFS_REMAP
+    return LittlefsRemapAddr((uint32_t)(uintptr_t)cfg->context, cfg->block_size, block);
+#else
+    return (uint32_t)(uintptr_t)cfg->context + cfg->block_size * block;
+#endif
+}
+
+#ifdef LOSCFG_NIOBE407_LITTLEFS_PROG_VERIFY
+/* compare flash with buf, an expect of NULL means erased */
+static int BdVerify(uint32_t addr, const uint8_t *expect, uint32_t size)
+{
+    uint8_t chunk[VERIFY_CHUNK];
+
+    for (uint32_t done = 0; done < size; done += VERIFY_CHUNK) {
+        uint32_t once = (size - done < VERIFY_CHUNK) ? (size - done) : VERIFY_CHUNK;
+        if (BdRead(addr + done, chunk, once) != HDF_SUCCESS) {
+            return LFS_ERR_IO;
+        }
+        for (uint32_t i = 0; i < once; i++) {
+            if (chunk[i] != ((expect != NULL) ? expect[done + i] : 0xFF)) {
+                return LFS_ERR_CORRUPT;
+            }
+        }
+    }
+    return LFS_ERR_OK;
+}
+#endif
+
 int32_t LittlefsRead(const struct lfs_config *cfg, lfs_block_t block,
     lfs_off_t off, void *buffer, lfs_size_t size)
 {
-    W25x_BufferRead(buffer, cfg->context + cfg->block_size * block + off, size);
-    return LFS_ERR_OK;
+    uint32_t addr = BdBlockAddr(cfg, block) + off;
+
+    for (int n = 0; n < BD_RETRIES; n++) {
+        if (BdRead(addr, buffer, size) == HDF_SUCCESS) {
+            return LFS_ERR_OK;
+        }
+    }
+    return LFS_ERR_IO;
 }
 
+/*
+ * LFS_ERR_CORRUPT makes littlefs move the data to another block. NOR bits
+ * only go from 1 to 0, so programming the same data again is harmless.
+ */
 int32_t LittlefsProg(const struct lfs_config *cfg, lfs_block_t block,
     lfs_off_t off, const void *buffer, lfs_size_t size)
 {
-    W25x_BufferWrite((uint8_t *)buffer, cfg->context + cfg->block_size * block + off,size);
-    return LFS_ERR_OK;
+    uint32_t addr = BdBlockAddr(cfg, block) + off;
+    int32_t err = LFS_ERR_IO;
+
+    for (int n = 0; n < BD_RETRIES && err != LFS_ERR_OK; n++) {
+        if (BdProg(addr, buffer, size) != HDF_SUCCESS) {
+            err = LFS_ERR_IO;
+            continue;
+        }
+#ifdef LOSCFG_NIOBE407_LITTLEFS_PROG_VERIFY
+        err = BdVerify(addr, buffer, size);
+#else
+        err = LFS_ERR_OK;
+#endif
+    }
+#ifdef LOSCFG_NIOBE407_LITTLEFS_REMAP
+    if (err == LFS_ERR_CORRUPT) {
+        /* littlefs still reads the block to relocate its data, so it is only retired on the next erase */
+        LittlefsRemapMarkPending((uint32_t)(uintptr_t)cfg->context, block);
+    }
+#endif
+    return err;
+}
+
+static int32_t BdEraseBlock(uint32_t addr, uint32_t size)
+{
+    int32_t err = LFS_ERR_IO;
+
+    for (int n = 0; n < BD_RETRIES && err != LFS_ERR_OK; n++) {
+        if (BdErase(addr, size) != HDF_SUCCESS) {
+            err = LFS_ERR_IO;
+            continue;
+        }
+#ifdef LOSCFG_NIOBE407_LITTLEFS_PROG_VERIFY
+        err = BdVerify(addr, NULL, size);
+#else
+        err = LFS_ERR_OK;
+#endif
+    }
+    return err;
 }
 
 int32_t LittlefsErase(const struct lfs_config *cfg, lfs_block_t block)
 {
-    W25x_SectorErase(cfg->context + cfg->block_size * block);
-    return LFS_ERR_OK;
+    int32_t err;
+
+#ifdef LOSCFG_NIOBE407_LITTLEFS_REMAP
+    if (LittlefsRemapTakePending((uint32_t)(uintptr_t)cfg->context, block)) {
+        (void)LittlefsRemapRetire((uint32_t)(uintptr_t)cfg->context, block);
+    }
+#endif
+    err = BdEraseBlock(BdBlockAddr(cfg, block), cfg->block_size);
+
+#ifdef LOSCFG_NIOBE407_LITTLEFS_WEAR_STATS
+    LittlefsWearRecord((uint32_t)(uintptr_t)cfg->context, block);
+#endif
+
+#ifdef LOSCFG_NIOBE407_LITTLEFS_REMAP
+    /* an erase that does not take is worn out, move littlefs to a spare so the block keeps its number */
+    while (err != LFS_ERR_OK && LittlefsRemapRetire((uint32_t)(uintptr_t)cfg->context, block) == HDF_SUCCESS) {
+        err = BdEraseBlock(BdBlockAddr(cfg, block), cfg->block_size);
+    }
+#endif
+    return err;
 }
 
 int32_t LittlefsSync(const struct lfs_config *cfg)
 {
+#ifdef LOSCFG_NIOBE407_LITTLEFS_WRITE_BACK
+    if (LittlefsWriteBackFlush() != HDF_SUCCESS) {
+        return LFS_ERR_IO;
+    }
+#endif
     return LFS_ERR_OK;
 }
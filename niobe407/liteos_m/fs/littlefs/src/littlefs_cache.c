@@ -0,0 +1,326 @@
+/*
+ * Copyright (c) 2022 Talkweb Co., Ltd.
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "littlefs_cache.h"
+#include "w25qxx.h"
+#include "hdf_log.h"
+#include "los_mux.h"
+#include "securec.h"
+#ifdef LOSCFG_NIOBE407_LITTLEFS_CACHE_WARM_BOOT
+#include "lfs_util.h"
+#include "stm32f4xx_hal.h"
+#endif
+
+#define CACHE_LINE_SIZE     LOSCFG_NIOBE407_LITTLEFS_CACHE_LINE_SIZE
+#define CACHE_LINES         LOSCFG_NIOBE407_LITTLEFS_CACHE_LINES
+#define CACHE_READ_AHEAD    LOSCFG_NIOBE407_LITTLEFS_READ_AHEAD
+#define CACHE_ADDR_INVALID  0xFFFFFFFF
+
+#if (CACHE_LINE_SIZE & (CACHE_LINE_SIZE - 1)) != 0
+#error "littlefs cache line size must be a power of two"
+#endif
+#if (CACHE_READ_AHEAD * 2) >= CACHE_LINES
+#error "littlefs cache read-ahead must stay below half the cache lines"
+#endif
+
+/* ccmram and .noinit are left alone by the startup code, so both keep the lines over a warm reset */
+#if defined(LOSCFG_NIOBE407_LITTLEFS_CACHE_CCMRAM)
+#define CACHE_DATA_SECTION  __attribute__((section(".ccmram")))
+#elif defined(LOSCFG_NIOBE407_LITTLEFS_CACHE_WARM_BOOT)
+#define CACHE_DATA_SECTION  __attribute__((section(".noinit")))
+#else
+#define CACHE_DATA_SECTION
+#endif
+
+#ifdef LOSCFG_NIOBE407_LITTLEFS_CACHE_WARM_BOOT
+#define CACHE_STATE_SECTION __attribute__((section(".noinit")))
+#define CACHE_WARM_MAGIC    0x4D524157 // "WARM"
+#else
+#define CACHE_STATE_SECTION
+#endif
+
+typedef struct {
+    uint32_t addr;      // flash address of the line, CACHE_ADDR_INVALID when empty
+    uint32_t lastUse;   // g_cacheClock at the last hit or fill, the smallest is evicted
+#ifdef LOSCFG_NIOBE407_LITTLEFS_CACHE_WARM_BOOT
+    uint32_t crc;       // over addr and data, checked before a line is trusted after reset
+#endif
+} CacheLine;
+
+#ifdef LOSCFG_NIOBE407_LITTLEFS_CACHE_WARM_BOOT
+typedef struct {
+    uint32_t magic;
+    uint32_t flashEnd;  // the lines belong to this chip size
+    uint32_t busy;      // set while flash changes under the lines, a reset then drops them all
+} CacheWarmState;
+
+static CACHE_STATE_SECTION CacheWarmState g_cacheWarm;
+#endif
+
+static CACHE_DATA_SECTION uint8_t g_cacheData[CACHE_LINES][CACHE_LINE_SIZE];
+static CACHE_STATE_SECTION CacheLine g_cacheLine[CACHE_LINES];
+static uint32_t g_cacheClock = 0;
+/* first line past the last fill, a miss there continues a sequential read */
+static uint32_t g_cacheSeqNext = CACHE_ADDR_INVALID;
+static uint32_t g_cacheFlashEnd = 0;
+static LittlefsCacheStat g_cacheStat;
+static UINT32 g_cacheMux;
+static BOOL g_cacheInited = FALSE;
+
+#ifdef LOSCFG_NIOBE407_LITTLEFS_CACHE_WARM_BOOT
+static uint32_t CacheLineCrc(int i)
+{
+    uint32_t crc = lfs_crc(0xFFFFFFFF, &g_cacheLine[i].addr, sizeof(g_cacheLine[i].addr));
+    return lfs_crc(crc, g_cacheData[i], CACHE_LINE_SIZE);
+}
+
+/*
+ * Only a soft or watchdog reset keeps the flash as the lines saw it, a pin
+ * reset may follow a programmer, bootloader or ota rewriting it. Every reset
+ * sets PINRSTF on the F4, so the cause is told by the other flags, which are
+ * cleared here for the next reset.
+ */
+static BOOL CacheWarmReset(void)
+{
+    uint32_t csr = RCC->CSR;
+
+    RCC->CSR |= RCC_CSR_RMVF;
+    return (csr & (RCC_CSR_SFTRSTF | RCC_CSR_IWDGRSTF | RCC_CSR_WWDGRSTF)) != 0 &&
+           (csr & (RCC_CSR_PORRSTF | RCC_CSR_BORRSTF)) == 0;
+}
+
+/* keep the lines left by a warm reset that still check out, so the next mount reads them from ram */
+static void CacheWarmRestore(uint32_t flashEnd)
+{
+    BOOL warm = CacheWarmReset() && g_cacheWarm.magic == CACHE_WARM_MAGIC && g_cacheWarm.flashEnd == flashEnd &&
+        g_cacheWarm.busy == 0;
+
+    for (int i = 0; i < CACHE_LINES; i++) {
+        uint32_t addr = g_cacheLine[i].addr;
+        if (warm && addr < flashEnd && (addr & (CACHE_LINE_SIZE - 1)) == 0 && g_cacheLine[i].crc == CacheLineCrc(i)) {
+            g_cacheClock = (g_cacheLine[i].lastUse > g_cacheClock) ? g_cacheLine[i].lastUse : g_cacheClock;
+            g_cacheStat.warmLines++;
+        } else {
+            g_cacheLine[i].addr = CACHE_ADDR_INVALID;
+            g_cacheLine[i].lastUse = 0;
+        }
+    }
+    g_cacheWarm.magic = CACHE_WARM_MAGIC;
+    g_cacheWarm.flashEnd = flashEnd;
+    g_cacheWarm.busy = 0;
+}
+#endif
+
+int32_t LittlefsCacheInit(void)
+{
+    W25xFlashInfo info;
+
+    if (g_cacheInited) {
+        return HDF_SUCCESS;
+    }
+    if (W25x_GetFlashInfo(&info) != HDF_SUCCESS || LOS_MuxCreate(&g_cacheMux) != LOS_OK) {
+        HDF_LOGE("%s: failed\n", __func__);
+        return HDF_FAILURE;
+    }
+#ifdef LOSCFG_NIOBE407_LITTLEFS_CACHE_WARM_BOOT
+    CacheWarmRestore(info.capacity);
+#else
+    for (int i = 0; i < CACHE_LINES; i++) {
+        g_cacheLine[i].addr = CACHE_ADDR_INVALID;
+        g_cacheLine[i].lastUse = 0;
+    }
+#endif
+    g_cacheFlashEnd = info.capacity;
+    g_cacheInited = TRUE;
+
+    return HDF_SUCCESS;
+}
+
+static int CacheLookup(uint32_t lineAddr)
+{
+    for (int i = 0; i < CACHE_LINES; i++) {
+        if (g_cacheLine[i].addr == lineAddr) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+static int CacheVictim(void)
+{
+    int victim = 0;
+    for (int i = 0; i < CACHE_LINES; i++) {
+        if (g_cacheLine[i].addr == CACHE_ADDR_INVALID) {
+            return i;
+        }
+        if (g_cacheLine[i].lastUse < g_cacheLine[victim].lastUse) {
+            victim = i;
+        }
+    }
+    return victim;
+}
+
+static int32_t CacheFillLine(uint32_t lineAddr, int *index)
+{
+    int i = CacheVictim();
+
+    g_cacheLine[i].addr = CACHE_ADDR_INVALID;
+    int32_t ret = W25x_DevRead(W25x_GetDefaultDev(), g_cacheData[i], lineAddr, CACHE_LINE_SIZE);
+    if (ret != HDF_SUCCESS) {
+        return ret;
+    }
+    g_cacheLine[i].addr = lineAddr;
+    g_cacheLine[i].lastUse = ++g_cacheClock;
+#ifdef LOSCFG_NIOBE407_LITTLEFS_CACHE_WARM_BOOT
+    g_cacheLine[i].crc = CacheLineCrc(i);
+#endif
+    *index = i;
+
+    return HDF_SUCCESS;
+}
+
+/* demand line first, then the lines after it when the miss continues the last fill */
+static int32_t CacheMiss(uint32_t lineAddr, int *index)
+{
+    int32_t ret = CacheFillLine(lineAddr, index);
+    if (ret != HDF_SUCCESS) {
+        return ret;
+    }
+    g_cacheStat.misses++;
+
+    uint32_t next = lineAddr + CACHE_LINE_SIZE;
+    if (lineAddr == g_cacheSeqNext) {
+        for (int n = 0; n < CACHE_READ_AHEAD && next < g_cacheFlashEnd && CacheLookup(next) < 0; n++) {
+            int ahead;
+            if (CacheFillLine(next, &ahead) != HDF_SUCCESS) {
+                break; // the demand line is in, read-ahead is best effort
+            }
+            g_cacheStat.readAheads++;
+            next += CACHE_LINE_SIZE;
+        }
+    }
+    g_cacheSeqNext = next;
+
+    return HDF_SUCCESS;
+}
+
+int32_t LittlefsCacheRead(uint32_t addr, uint8_t *buf, uint32_t size)
+{
+    int32_t ret = HDF_SUCCESS;
+
+    /* lines are never dirty, so flash is always current and large reads can skip the cache */
+    if (!g_cacheInited || size >= CACHE_LINE_SIZE) {
+        g_cacheStat.bypasses++;
+        return W25x_DevRead(W25x_GetDefaultDev(), buf, addr, size);
+    }
+
+    (void)LOS_MuxPend(g_cacheMux, LOS_WAIT_FOREVER);
+    while (size > 0 && ret == HDF_SUCCESS) {
+        uint32_t lineAddr = addr & ~(CACHE_LINE_SIZE - 1);
+        uint32_t off = addr - lineAddr;
+        uint32_t once = (CACHE_LINE_SIZE - off < size) ? (CACHE_LINE_SIZE - off) : size;
+        int i = CacheLookup(lineAddr);
+        if (i >= 0) {
+            g_cacheStat.hits++;
+            g_cacheLine[i].lastUse = ++g_cacheClock;
+        } else {
+            ret = CacheMiss(lineAddr, &i);
+            if (ret != HDF_SUCCESS) {
+                break;
+            }
+        }
+        (void)memcpy_s(buf, once, &g_cacheData[i][off], once);
+        addr += once;
+        buf += once;
+        size -= once;
+    }
+    (void)LOS_MuxPost(g_cacheMux);
+
+    return ret;
+}
+
+/* called with g_cacheMux held */
+static void CacheInvalidate(uint32_t addr, uint32_t size)
+{
+    for (int i = 0; i < CACHE_LINES; i++) {
+        uint32_t lineAddr = g_cacheLine[i].addr;
+        if (lineAddr != CACHE_ADDR_INVALID && lineAddr < addr + size && addr < lineAddr + CACHE_LINE_SIZE) {
+            g_cacheLine[i].addr = CACHE_ADDR_INVALID;
+            g_cacheStat.invalidates++;
+        }
+    }
+}
+
+static inline void CacheWarmBusy(uint32_t busy)
+{
+#ifdef LOSCFG_NIOBE407_LITTLEFS_CACHE_WARM_BOOT
+    g_cacheWarm.busy = busy;
+#else
+    (void)busy;
+#endif
+}
+
+/* the flash op and the invalidate happen under the cache lock, so no read can refill an old copy in between */
+int32_t LittlefsCacheProg(uint32_t addr, const uint8_t *buf, uint32_t size)
+{
+    if (!g_cacheInited) {
+        return W25x_DevWrite(W25x_GetDefaultDev(), buf, addr, size);
+    }
+    (void)LOS_MuxPend(g_cacheMux, LOS_WAIT_FOREVER);
+    CacheWarmBusy(1);
+    int32_t ret = W25x_DevWrite(W25x_GetDefaultDev(), buf, addr, size);
+    CacheInvalidate(addr, size);
+    CacheWarmBusy(0);
+    (void)LOS_MuxPost(g_cacheMux);
+
+    return ret;
+}
+
+int32_t LittlefsCacheErase(uint32_t addr, uint32_t size)
+{
+    if (!g_cacheInited) {
+        return W25x_DevEraseRange(W25x_GetDefaultDev(), addr, size);
+    }
+    (void)LOS_MuxPend(g_cacheMux, LOS_WAIT_FOREVER);
+    CacheWarmBusy(1);
+    int32_t ret = W25x_DevEraseRange(W25x_GetDefaultDev(), addr, size);
+    CacheInvalidate(addr, size);
+    CacheWarmBusy(0);
+    (void)LOS_MuxPost(g_cacheMux);
+
+    return ret;
+}
+
+void LittlefsCacheGetStat(LittlefsCacheStat *stat)
+{
+    if (stat != NULL) {
+        (void)memcpy_s(stat, sizeof(*stat), &g_cacheStat, sizeof(g_cacheStat));
+    }
+}
+
+void LittlefsCacheResetStat(void)
+{
+    (void)memset_s(&g_cacheStat, sizeof(g_cacheStat), 0, sizeof(g_cacheStat));
+}
+
+void LittlefsCacheDumpStat(void)
+{
+    uint32_t lookups = g_cacheStat.hits + g_cacheStat.misses;
+
+    HDF_LOGI("littlefs cache: %u x %u bytes, hit %u, miss %u (%u%% hit), read-ahead %u, bypass %u, invalidate %u, "
+        "warm %u\n", CACHE_LINES, CACHE_LINE_SIZE, g_cacheStat.hits, g_cacheStat.misses,
+        (lookups != 0) ? (g_cacheStat.hits * 100 / lookups) : 0, g_cacheStat.readAheads,
+        g_cacheStat.bypasses, g_cacheStat.invalidates, g_cacheStat.warmLines);
+}
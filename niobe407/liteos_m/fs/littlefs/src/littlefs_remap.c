@@ -0,0 +1,250 @@
+/*
+ * Copyright (c) 2022 Talkweb Co., Ltd.
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "littlefs_remap.h"
+#include "w25qxx.h"
+#include "hdf_log.h"
+#include "lfs_util.h"
+#include "los_config.h"
+#include "los_mux.h"
+#include "securec.h"
+
+#define REMAP_SPARES        LOSCFG_NIOBE407_LITTLEFS_SPARE_BLOCKS
+#define REMAP_TABLE_BLOCKS  2 // written alternately, a power cut mid update leaves the older one
+#define REMAP_MAGIC         0x4D52464C // "LFRM"
+
+typedef struct {
+    uint32_t bad;       // block index littlefs uses
+    uint32_t spare;     // block index it is stored at
+} RemapEntry;
+
+typedef struct {
+    uint32_t magic;
+    uint32_t seq;       // the valid table with the higher seq wins
+    uint32_t count;     // entries in use
+    uint32_t used;      // spares handed out, failed spares are not reused
+    RemapEntry entry[REMAP_SPARES];
+    uint32_t crc;
+} RemapTable;
+
+typedef struct {
+    uint32_t base;          // partition flash address, 0 when the slot is free
+    uint32_t blockSize;
+    uint32_t spareFirst;    // first spare block index, the block count littlefs sees
+    uint32_t tableBlock;    // block index of the table written last
+    uint32_t pendingCount;
+    uint32_t pending[REMAP_SPARES]; // failed a prog, retired on their next erase
+    RemapTable table;
+} RemapPart;
+
+static RemapPart g_remapPart[LOSCFG_LFS_MAX_MOUNT_SIZE];
+static UINT32 g_remapMux;
+static BOOL g_remapInited = FALSE;
+
+static RemapPart *RemapFind(uint32_t base)
+{
+    for (int i = 0; i < LOSCFG_LFS_MAX_MOUNT_SIZE; i++) {
+        if (g_remapPart[i].blockSize != 0 && g_remapPart[i].base == base) {
+            return &g_remapPart[i];
+        }
+    }
+    return NULL;
+}
+
+static uint32_t RemapTableCrc(const RemapTable *table)
+{
+    return lfs_crc(0xFFFFFFFF, table, offsetof(RemapTable, crc));
+}
+
+static BOOL RemapLoadTable(const RemapPart *part, uint32_t block, RemapTable *table)
+{
+    uint32_t addr = part->base + part->blockSize * block;
+
+    if (W25x_DevRead(W25x_GetDefaultDev(), (uint8_t *)table, addr, sizeof(*table)) != HDF_SUCCESS) {
+        return FALSE;
+    }
+    return table->magic == REMAP_MAGIC && table->count <= REMAP_SPARES && table->used <= REMAP_SPARES &&
+           table->crc == RemapTableCrc(table);
+}
+
+/* write table with the next seq to the table block not holding the current one */
+static int32_t RemapStoreTable(RemapPart *part, RemapTable *table)
+{
+    uint32_t block = part->spareFirst + REMAP_SPARES + ((part->tableBlock - part->spareFirst - REMAP_SPARES) ^ 1);
+    uint32_t addr = part->base + part->blockSize * block;
+    W25xDev *dev = W25x_GetDefaultDev();
+
+    table->seq = part->table.seq + 1;
+    table->crc = RemapTableCrc(table);
+    if (W25x_DevEraseRange(dev, addr, part->blockSize) != HDF_SUCCESS ||
+        W25x_DevWrite(dev, (const uint8_t *)table, addr, sizeof(*table)) != HDF_SUCCESS) {
+        HDF_LOGE("%s: remap table at 0x%x not written\n", __func__, addr);
+        return HDF_FAILURE;
+    }
+    part->tableBlock = block;
+
+    return HDF_SUCCESS;
+}
+
+int32_t LittlefsRemapAttach(uint32_t base, uint32_t blockSize, uint32_t *blockCount)
+{
+    RemapPart *part = NULL;
+    RemapTable table;
+
+    if (!g_remapInited) {
+        if (LOS_MuxCreate(&g_remapMux) != LOS_OK) {
+            return HDF_FAILURE;
+        }
+        g_remapInited = TRUE;
+    }
+    if (*blockCount <= REMAP_SPARES + REMAP_TABLE_BLOCKS || sizeof(RemapTable) > blockSize) {
+        HDF_LOGE("%s: partition 0x%x too small for %u spare blocks\n", __func__, base, REMAP_SPARES);
+        return HDF_FAILURE;
+    }
+    for (int i = 0; i < LOSCFG_LFS_MAX_MOUNT_SIZE && part == NULL; i++) {
+        if (g_remapPart[i].blockSize == 0) {
+            part = &g_remapPart[i];
+        }
+    }
+    if (part == NULL) {
+        return HDF_FAILURE;
+    }
+
+    (void)memset_s(part, sizeof(*part), 0, sizeof(*part));
+    part->base = base;
+    part->blockSize = blockSize;
+    part->spareFirst = *blockCount - REMAP_SPARES - REMAP_TABLE_BLOCKS;
+    part->tableBlock = part->spareFirst + REMAP_SPARES + 1; // so the first store goes to the first table block
+    part->table.magic = REMAP_MAGIC;
+    for (uint32_t n = 0; n < REMAP_TABLE_BLOCKS; n++) {
+        uint32_t block = part->spareFirst + REMAP_SPARES + n;
+        if (RemapLoadTable(part, block, &table) && (part->table.seq == 0 || (int32_t)(table.seq - part->table.seq) > 0)) {
+            (void)memcpy_s(&part->table, sizeof(part->table), &table, sizeof(table));
+            part->tableBlock = block;
+        }
+    }
+    *blockCount = part->spareFirst;
+    HDF_LOGI("%s: partition 0x%x, %u blocks, %u of %u spares used, %u remapped\n", __func__, base,
+             *blockCount, part->table.used, REMAP_SPARES, part->table.count);
+
+    return HDF_SUCCESS;
+}
+
+uint32_t LittlefsRemapAddr(uint32_t base, uint32_t blockSize, uint32_t block)
+{
+    RemapPart *part = RemapFind(base);
+
+    if (part != NULL && part->table.count != 0) {
+        for (uint32_t i = 0; i < part->table.count; i++) {
+            if (part->table.entry[i].bad == block) {
+                block = part->table.entry[i].spare;
+                break;
+            }
+        }
+    }
+    return base + blockSize * block;
+}
+
+/*
+ * Point block at the next unused spare, a block already remapped gives up its
+ * failed spare. The change is made on a copy and only takes effect once the
+ * table is on flash, so the mapping in use always matches the one after reboot.
+ */
+int32_t LittlefsRemapRetire(uint32_t base, uint32_t block)
+{
+    RemapPart *part = RemapFind(base);
+    RemapTable table;
+    int32_t ret = HDF_FAILURE;
+    uint32_t i = 0;
+
+    if (part == NULL) {
+        return HDF_FAILURE;
+    }
+    (void)LOS_MuxPend(g_remapMux, LOS_WAIT_FOREVER);
+    (void)memcpy_s(&table, sizeof(table), &part->table, sizeof(part->table));
+    while (i < table.count && table.entry[i].bad != block) {
+        i++;
+    }
+    /* spares are never erased before, one that will not erase is skipped like a failed one */
+    while (table.used < REMAP_SPARES && ret != HDF_SUCCESS) {
+        uint32_t spare = part->spareFirst + table.used++;
+        if (W25x_DevEraseRange(W25x_GetDefaultDev(), part->base + part->blockSize * spare,
+            part->blockSize) != HDF_SUCCESS) {
+            continue;
+        }
+        table.entry[i].bad = block;
+        table.entry[i].spare = spare;
+        table.count = (i == table.count) ? (i + 1) : table.count;
+        ret = RemapStoreTable(part, &table);
+        if (ret != HDF_SUCCESS) {
+            break;
+        }
+        (void)memcpy_s(&part->table, sizeof(part->table), &table, sizeof(table));
+        HDF_LOGE("%s: partition 0x%x block %u moved to spare %u\n", __func__, base, block, spare);
+    }
+    if (table.used >= REMAP_SPARES && ret != HDF_SUCCESS) {
+        HDF_LOGE("%s: partition 0x%x out of spares, block %u stays bad\n", __func__, base, block);
+    }
+    (void)LOS_MuxPost(g_remapMux);
+
+    return ret;
+}
+
+void LittlefsRemapMarkPending(uint32_t base, uint32_t block)
+{
+    RemapPart *part = RemapFind(base);
+
+    if (part == NULL) {
+        return;
+    }
+    (void)LOS_MuxPend(g_remapMux, LOS_WAIT_FOREVER);
+    uint32_t i = 0;
+    while (i < part->pendingCount && part->pending[i] != block) {
+        i++;
+    }
+    /* more pending blocks than spares could not all be retired anyway */
+    if (i == part->pendingCount && i < REMAP_SPARES) {
+        part->pending[part->pendingCount++] = block;
+    }
+    (void)LOS_MuxPost(g_remapMux);
+}
+
+bool LittlefsRemapTakePending(uint32_t base, uint32_t block)
+{
+    RemapPart *part = RemapFind(base);
+    bool found = false;
+
+    if (part == NULL || part->pendingCount == 0) {
+        return false;
+    }
+    (void)LOS_MuxPend(g_remapMux, LOS_WAIT_FOREVER);
+    for (uint32_t i = 0; i < part->pendingCount; i++) {
+        if (part->pending[i] == block) {
+            part->pending[i] = part->pending[--part->pendingCount];
+            found = true;
+            break;
+        }
+    }
+    (void)LOS_MuxPost(g_remapMux);
+
+    return found;
+}
+
+uint32_t LittlefsRemapCount(uint32_t base)
+{
+    RemapPart *part = RemapFind(base);
+
+    return (part != NULL) ? part->table.count : 0;
+}
@@ -0,0 +1,330 @@
+/*
+ * Copyright (c) 2022 Talkweb Co., Ltd.
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "littlefs_stream.h"
+#include <fcntl.h>
+#include <unistd.h>
+#include "hdf_base.h"
+#include "hdf_log.h"
+#include "los_config.h"
+#include "los_event.h"
+#include "los_memory.h"
+#include "los_queue.h"
+#include "los_task.h"
+#include "securec.h"
+
+#define STREAM_BUF_SIZE         LITTLEFS_STREAM_BUF_SIZE
+#define STREAM_BUFS             LOSCFG_NIOBE407_LITTLEFS_STREAM_BUFS
+#define STREAM_READ_AHEAD       (STREAM_BUFS / 2)
+#define STREAM_BUF_ALIGN        32  // whole dma bursts
+#define STREAM_WORK_DEPTH       (STREAM_BUFS * 2)
+#define STREAM_CLOSED_EVENT     0x1
+#define STREAM_TASK_STACK_SIZE  0x1000
+#define STREAM_TASK_NAME        "lfs_stream"
+#define STREAM_TASK_PRIORITY    20
+
+#if (STREAM_BUF_SIZE % STREAM_BUF_ALIGN) != 0
+#error "littlefs stream buffer size must be a multiple of 32"
+#endif
+
+typedef enum {
+    STREAM_REQ_WRITE = 0,
+    STREAM_REQ_PBUF,
+    STREAM_REQ_READ,
+    STREAM_REQ_CLOSE,
+} StreamReqType;
+
+typedef struct {
+    LittlefsStream *stream;
+    uint8_t type;
+    uint32_t len;
+    void *buf;      // pool buffer, or the pbuf chain for STREAM_REQ_PBUF
+} StreamReq;
+
+typedef struct {
+    uint8_t *buf;
+    int32_t len;    // bytes read, negative on error
+} StreamChunk;
+
+struct LittlefsStream {
+    int fd;
+    BOOL reading;
+    BOOL eof;               // a short read was handed out, no more read-ahead
+    uint32_t pending;       // read-ahead requests not yet taken by the caller
+    volatile int32_t err;   // first failed write, later writes are dropped
+    int32_t closeRet;
+    UINT32 readyQueue;      // StreamChunk, filled by the stream task
+    EVENT_CB_S event;
+};
+
+static uint8_t g_streamBuf[STREAM_BUFS][STREAM_BUF_SIZE] __attribute__((aligned(STREAM_BUF_ALIGN)));
+static UINT32 g_streamFreeQueue;
+static UINT32 g_streamWorkQueue;
+static BOOL g_streamInited = FALSE;
+
+static void StreamWrite(LittlefsStream *stream, const uint8_t *buf, uint32_t len)
+{
+    if (stream->err == 0 && _write(stream->fd, buf, len) != (ssize_t)len) {
+        stream->err = HDF_FAILURE;
+    }
+}
+
+static void StreamHandle(const StreamReq *req)
+{
+    LittlefsStream *stream = req->stream;
+    StreamChunk chunk;
+
+    switch (req->type) {
+        case STREAM_REQ_WRITE:
+            StreamWrite(stream, req->buf, req->len);
+            LittlefsStreamBufPut(req->buf);
+            break;
+#ifdef LOSCFG_NET_LWIP
+        case STREAM_REQ_PBUF:
+            for (struct pbuf *q = req->buf; q != NULL; q = q->next) {
+                StreamWrite(stream, q->payload, q->len);
+            }
+            (void)pbuf_free(req->buf);
+            break;
+#endif
+        case STREAM_REQ_READ:
+            chunk.buf = req->buf;
+            chunk.len = _read(stream->fd, chunk.buf, STREAM_BUF_SIZE);
+            (void)LOS_QueueWriteCopy(stream->readyQueue, &chunk, sizeof(chunk), LOS_WAIT_FOREVER);
+            break;
+        case STREAM_REQ_CLOSE:
+            stream->closeRet = (_close(stream->fd) == 0) ? stream->err : HDF_FAILURE;
+            (void)LOS_EventWrite(&stream->event, STREAM_CLOSED_EVENT);
+            break;
+        default:
+            break;
+    }
+}
+
+static void StreamTaskEntry(void)
+{
+    StreamReq req;
+    UINT32 size;
+
+    while (1) {
+        size = sizeof(req);
+        if (LOS_QueueReadCopy(g_streamWorkQueue, &req, &size, LOS_WAIT_FOREVER) == LOS_OK) {
+            StreamHandle(&req);
+        }
+    }
+}
+
+int32_t LittlefsStreamInit(void)
+{
+    UINT32 taskID;
+    TSK_INIT_PARAM_S stTask = {0};
+
+    if (g_streamInited) {
+        return HDF_SUCCESS;
+    }
+    if (LOS_QueueCreate("lfs_sfree", STREAM_BUFS, &g_streamFreeQueue, 0, sizeof(uint8_t *)) != LOS_OK ||
+        LOS_QueueCreate("lfs_swork", STREAM_WORK_DEPTH, &g_streamWorkQueue, 0, sizeof(StreamReq)) != LOS_OK) {
+        HDF_LOGE("%s: queue create failed\n", __func__);
+        return HDF_FAILURE;
+    }
+    for (int i = 0; i < STREAM_BUFS; i++) {
+        uint8_t *buf = g_streamBuf[i];
+        (void)LOS_QueueWriteCopy(g_streamFreeQueue, &buf, sizeof(buf), LOS_NO_WAIT);
+    }
+
+    stTask.pfnTaskEntry = (TSK_ENTRY_FUNC)StreamTaskEntry;
+    stTask.uwStackSize = STREAM_TASK_STACK_SIZE;
+    stTask.pcName = STREAM_TASK_NAME;
+    stTask.usTaskPrio = STREAM_TASK_PRIORITY;
+    if (LOS_TaskCreate(&taskID, &stTask) != LOS_OK) {
+        HDF_LOGE("%s: stream task create failed\n", __func__);
+        return HDF_FAILURE;
+    }
+    g_streamInited = TRUE;
+
+    return HDF_SUCCESS;
+}
+
+uint8_t *LittlefsStreamBufGet(uint32_t timeoutMs)
+{
+    uint8_t *buf = NULL;
+    UINT32 size = sizeof(buf);
+
+    if (!g_streamInited) {
+        return NULL;
+    }
+    UINT32 timeout = (timeoutMs == LOS_WAIT_FOREVER) ? LOS_WAIT_FOREVER : LOS_MS2Tick(timeoutMs);
+    if (LOS_QueueReadCopy(g_streamFreeQueue, &buf, &size, timeout) != LOS_OK) {
+        return NULL;
+    }
+    return buf;
+}
+
+void LittlefsStreamBufPut(uint8_t *buf)
+{
+    if (buf != NULL) {
+        (void)LOS_QueueWriteCopy(g_streamFreeQueue, &buf, sizeof(buf), LOS_NO_WAIT);
+    }
+}
+
+static int32_t StreamQueue(LittlefsStream *stream, uint8_t type, void *buf, uint32_t len)
+{
+    StreamReq req = {
+        .stream = stream,
+        .type = type,
+        .len = len,
+        .buf = buf,
+    };
+    return (LOS_QueueWriteCopy(g_streamWorkQueue, &req, sizeof(req), LOS_WAIT_FOREVER) == LOS_OK) ?
+        HDF_SUCCESS : HDF_FAILURE;
+}
+
+/* read-ahead only takes free buffers, the read the caller waits on may block for one */
+static int32_t StreamReadAhead(LittlefsStream *stream, uint32_t timeoutMs)
+{
+    uint8_t *buf = LittlefsStreamBufGet(timeoutMs);
+
+    if (buf == NULL || StreamQueue(stream, STREAM_REQ_READ, buf, STREAM_BUF_SIZE) != HDF_SUCCESS) {
+        LittlefsStreamBufPut(buf);
+        return HDF_FAILURE;
+    }
+    stream->pending++;
+    return HDF_SUCCESS;
+}
+
+LittlefsStream *LittlefsStreamOpen(const char *path, int oflags)
+{
+    LittlefsStream *stream = NULL;
+
+    if (!g_streamInited || path == NULL) {
+        return NULL;
+    }
+    stream = LOS_MemAlloc(OS_SYS_MEM_ADDR, sizeof(*stream));
+    if (stream == NULL) {
+        return NULL;
+    }
+    (void)memset_s(stream, sizeof(*stream), 0, sizeof(*stream));
+    stream->reading = ((oflags & O_ACCMODE) == O_RDONLY);
+    if (LOS_EventInit(&stream->event) != LOS_OK || (stream->reading &&
+        LOS_QueueCreate("lfs_sread", STREAM_READ_AHEAD, &stream->readyQueue, 0, sizeof(StreamChunk)) != LOS_OK)) {
+        (void)LOS_MemFree(OS_SYS_MEM_ADDR, stream);
+        return NULL;
+    }
+    stream->fd = _open(path, oflags);
+    if (stream->fd < 0) {
+        HDF_LOGE("%s: open %s failed\n", __func__, path);
+        if (stream->reading) {
+            (void)LOS_QueueDelete(stream->readyQueue);
+        }
+        (void)LOS_EventDestroy(&stream->event);
+        (void)LOS_MemFree(OS_SYS_MEM_ADDR, stream);
+        return NULL;
+    }
+    for (int i = 0; stream->reading && i < STREAM_READ_AHEAD; i++) {
+        (void)StreamReadAhead(stream, LOS_NO_WAIT);
+    }
+    return stream;
+}
+
+int32_t LittlefsStreamSubmit(LittlefsStream *stream, uint8_t *buf, uint32_t len)
+{
+    if (stream == NULL || stream->reading || buf == NULL || len > STREAM_BUF_SIZE) {
+        LittlefsStreamBufPut(buf);
+        return HDF_FAILURE;
+    }
+    if (stream->err != 0 || len == 0) {
+        LittlefsStreamBufPut(buf);
+        return stream->err;
+    }
+    return StreamQueue(stream, STREAM_REQ_WRITE, buf, len);
+}
+
+#ifdef LOSCFG_NET_LWIP
+int32_t LittlefsStreamSubmitPbuf(LittlefsStream *stream, struct pbuf *p)
+{
+    if (p == NULL) {
+        return HDF_ERR_INVALID_PARAM;
+    }
+    if (stream == NULL || stream->reading || stream->err != 0) {
+        (void)pbuf_free(p);
+        return HDF_FAILURE;
+    }
+    if (StreamQueue(stream, STREAM_REQ_PBUF, p, p->tot_len) != HDF_SUCCESS) {
+        (void)pbuf_free(p);
+        return HDF_FAILURE;
+    }
+    return HDF_SUCCESS;
+}
+#endif
+
+int32_t LittlefsStreamRead(LittlefsStream *stream, uint8_t **buf, uint32_t timeoutMs)
+{
+    StreamChunk chunk;
+    UINT32 size = sizeof(chunk);
+
+    if (stream == NULL || !stream->reading || buf == NULL) {
+        return HDF_FAILURE;
+    }
+    *buf = NULL;
+    if (stream->pending == 0 && (stream->eof || StreamReadAhead(stream, timeoutMs) != HDF_SUCCESS)) {
+        return stream->eof ? 0 : HDF_ERR_TIMEOUT;
+    }
+    UINT32 timeout = (timeoutMs == LOS_WAIT_FOREVER) ? LOS_WAIT_FOREVER : LOS_MS2Tick(timeoutMs);
+    if (LOS_QueueReadCopy(stream->readyQueue, &chunk, &size, timeout) != LOS_OK) {
+        return HDF_ERR_TIMEOUT;
+    }
+    stream->pending--;
+    if (chunk.len < STREAM_BUF_SIZE) {
+        stream->eof = TRUE;
+    }
+    if (!stream->eof) {
+        (void)StreamReadAhead(stream, LOS_NO_WAIT);
+    }
+    if (chunk.len <= 0) {
+        LittlefsStreamBufPut(chunk.buf);
+        return chunk.len;
+    }
+    *buf = chunk.buf;
+    return chunk.len;
+}
+
+int32_t LittlefsStreamClose(LittlefsStream *stream)
+{
+    StreamChunk chunk;
+    UINT32 size;
+
+    if (stream == NULL) {
+        return HDF_FAILURE;
+    }
+    while (stream->reading && stream->pending > 0) {
+        size = sizeof(chunk);
+        if (LOS_QueueReadCopy(stream->readyQueue, &chunk, &size, LOS_WAIT_FOREVER) == LOS_OK) {
+            LittlefsStreamBufPut(chunk.buf);
+            stream->pending--;
+        }
+    }
+    if (StreamQueue(stream, STREAM_REQ_CLOSE, NULL, 0) != HDF_SUCCESS) {
+        return HDF_FAILURE;
+    }
+    (void)LOS_EventRead(&stream->event, STREAM_CLOSED_EVENT, LOS_WAITMODE_OR | LOS_WAITMODE_CLR, LOS_WAIT_FOREVER);
+
+    int32_t ret = stream->closeRet;
+    if (stream->reading) {
+        (void)LOS_QueueDelete(stream->readyQueue);
+    }
+    (void)LOS_EventDestroy(&stream->event);
+    (void)LOS_MemFree(OS_SYS_MEM_ADDR, stream);
+    return ret;
+}
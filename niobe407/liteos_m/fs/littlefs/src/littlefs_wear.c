@@ -0,0 +1,184 @@
+/*
+ * Copyright (c) 2022 Talkweb Co., Ltd.
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "littlefs_wear.h"
+#include <stdio.h>
+#include <string.h>
+#include "hdf_base.h"
+#include "hdf_log.h"
+#include "los_config.h"
+#include "los_memory.h"
+#include "los_task.h"
+#include "securec.h"
+#ifdef LOSCFG_SHELL
+#include "shcmd.h"
+#endif
+
+#define WEAR_RATED_CYCLES   LOSCFG_NIOBE407_LITTLEFS_RATED_CYCLES
+#define WEAR_COUNT_MAX      0xFFFF
+#define WEAR_SECONDS_PER_DAY 86400
+
+typedef struct {
+    const char *mountPoint;
+    uint32_t base;
+    uint32_t blockCount;
+    uint16_t *erases;   // saturates at WEAR_COUNT_MAX
+} WearPart;
+
+static WearPart g_wearPart[LOSCFG_LFS_MAX_MOUNT_SIZE];
+static UINT64 g_wearStartTick = 0;
+
+#ifdef LOSCFG_SHELL
+static UINT32 WearShellCmd(UINT32 argc, const CHAR **argv)
+{
+    (void)argc;
+    (void)argv;
+    LittlefsWearDump();
+    return LOS_OK;
+}
+#endif
+
+int32_t LittlefsWearAttach(const char *mountPoint, uint32_t base, uint32_t blockCount)
+{
+    WearPart *part = NULL;
+
+    for (int i = 0; i < LOSCFG_LFS_MAX_MOUNT_SIZE && part == NULL; i++) {
+        if (g_wearPart[i].erases == NULL) {
+            part = &g_wearPart[i];
+        }
+    }
+    if (part == NULL || blockCount == 0) {
+        return HDF_FAILURE;
+    }
+    part->erases = LOS_MemAlloc(OS_SYS_MEM_ADDR, blockCount * sizeof(uint16_t));
+    if (part->erases == NULL) {
+        HDF_LOGE("%s: no memory for %u erase counters\n", __func__, blockCount);
+        return HDF_FAILURE;
+    }
+    (void)memset_s(part->erases, blockCount * sizeof(uint16_t), 0, blockCount * sizeof(uint16_t));
+    part->mountPoint = mountPoint;
+    part->base = base;
+    part->blockCount = blockCount;
+
+    if (part == &g_wearPart[0]) {
+        g_wearStartTick = LOS_TickCountGet();
+#ifdef LOSCFG_SHELL
+        (void)osCmdReg(CMD_TYPE_EX, "lfswear", 0, (CmdCallBackFunc)WearShellCmd);
+#endif
+    }
+    return HDF_SUCCESS;
+}
+
+void LittlefsWearRecord(uint32_t base, uint32_t block)
+{
+    for (int i = 0; i < LOSCFG_LFS_MAX_MOUNT_SIZE; i++) {
+        WearPart *part = &g_wearPart[i];
+        if (part->erases != NULL && part->base == base) {
+            if (block < part->blockCount && part->erases[block] < WEAR_COUNT_MAX) {
+                part->erases[block]++;
+            }
+            return;
+        }
+    }
+}
+
+static uint32_t WearBucket(uint32_t erases)
+{
+    uint32_t bucket = 0;
+    while (erases != 0 && bucket < LITTLEFS_WEAR_BUCKETS - 1) {
+        erases >>= 1;
+        bucket++;
+    }
+    return bucket;
+}
+
+/* keep the hottest blocks sorted, most erased first */
+static void WearInsertHot(LittlefsWearStat *stat, uint32_t block, uint32_t erases)
+{
+    int i = LITTLEFS_WEAR_HOT_BLOCKS - 1;
+
+    if (erases <= stat->hotErases[i]) {
+        return;
+    }
+    while (i > 0 && erases > stat->hotErases[i - 1]) {
+        stat->hotErases[i] = stat->hotErases[i - 1];
+        stat->hotBlock[i] = stat->hotBlock[i - 1];
+        i--;
+    }
+    stat->hotErases[i] = erases;
+    stat->hotBlock[i] = block;
+}
+
+int32_t LittlefsWearGetStat(const char *mountPoint, LittlefsWearStat *stat)
+{
+    const WearPart *part = NULL;
+
+    for (int i = 0; i < LOSCFG_LFS_MAX_MOUNT_SIZE && part == NULL; i++) {
+        if (g_wearPart[i].erases != NULL && mountPoint != NULL && strcmp(g_wearPart[i].mountPoint, mountPoint) == 0) {
+            part = &g_wearPart[i];
+        }
+    }
+    if (part == NULL || stat == NULL) {
+        return HDF_FAILURE;
+    }
+
+    (void)memset_s(stat, sizeof(*stat), 0, sizeof(*stat));
+    stat->blocks = part->blockCount;
+    stat->minErases = WEAR_COUNT_MAX;
+    for (uint32_t b = 0; b < part->blockCount; b++) {
+        uint32_t erases = part->erases[b];
+        stat->totalErases += erases;
+        stat->minErases = (erases < stat->minErases) ? erases : stat->minErases;
+        stat->maxErases = (erases > stat->maxErases) ? erases : stat->maxErases;
+        stat->histogram[WearBucket(erases)]++;
+        WearInsertHot(stat, b, erases);
+    }
+
+    stat->seconds = (uint32_t)((LOS_TickCountGet() - g_wearStartTick) / LOSCFG_BASE_CORE_TICK_PER_SECOND);
+    stat->lifetimeDays = LITTLEFS_WEAR_NO_ESTIMATE;
+    if (stat->maxErases >= WEAR_RATED_CYCLES) {
+        stat->lifetimeDays = 0;
+    } else if (stat->maxErases != 0 && stat->seconds != 0) {
+        UINT64 left = (UINT64)(WEAR_RATED_CYCLES - stat->maxErases) * stat->seconds / stat->maxErases;
+        stat->lifetimeDays = (uint32_t)(left / WEAR_SECONDS_PER_DAY);
+    }
+    return HDF_SUCCESS;
+}
+
+void LittlefsWearDump(void)
+{
+    LittlefsWearStat stat;
+
+    for (int i = 0; i < LOSCFG_LFS_MAX_MOUNT_SIZE; i++) {
+        if (g_wearPart[i].erases == NULL || LittlefsWearGetStat(g_wearPart[i].mountPoint, &stat) != HDF_SUCCESS) {
+            continue;
+        }
+        printf("%s: %u blocks, %u erases in %u s, min %u avg %u max %u\r\n", g_wearPart[i].mountPoint,
+            stat.blocks, stat.totalErases, stat.seconds, stat.minErases, stat.totalErases / stat.blocks,
+            stat.maxErases);
+        printf("  erases  0:%u 1:%u 2-3:%u 4-7:%u 8-15:%u 16-31:%u 32-63:%u 64+:%u\r\n", stat.histogram[0],
+            stat.histogram[1], stat.histogram[2], stat.histogram[3], stat.histogram[4], stat.histogram[5],
+            stat.histogram[6], stat.histogram[7]);
+        printf("  hottest");
+        for (int h = 0; h < LITTLEFS_WEAR_HOT_BLOCKS && stat.hotErases[h] != 0; h++) {
+            printf(" %u:%u", stat.hotBlock[h], stat.hotErases[h]);
+        }
+        if (stat.lifetimeDays == LITTLEFS_WEAR_NO_ESTIMATE) {
+            printf("\r\n  lifetime: no erases yet\r\n");
+        } else {
+            printf("\r\n  lifetime: %u days to %u cycles at this rate\r\n", stat.lifetimeDays, WEAR_RATED_CYCLES);
+        }
+    }
+}
@@ -0,0 +1,336 @@
+/*
+ * Copyright (c) 2022 Talkweb Co., Ltd.
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "littlefs_writeback.h"
+#include "w25qxx.h"
+#include "hdf_log.h"
+#ifdef LOSCFG_NIOBE407_LITTLEFS_CACHE
+#include "littlefs_cache.h"
+#endif
+#include "los_task.h"
+#include "los_mux.h"
+#include "los_event.h"
+#include "securec.h"
+
+#define WB_SLOTS                LOSCFG_NIOBE407_LITTLEFS_WB_SLOTS
+#define WB_FLUSH_MS             LOSCFG_NIOBE407_LITTLEFS_WB_FLUSH_MS
+#define WB_PAGE_MAX             256 // largest page the w25qxx driver programs at once
+#define WB_ADDR_INVALID         0xFFFFFFFF
+#define WB_EVENT_FLUSH          0x1
+#define WB_FLUSHER_STACK_SIZE   0x800
+#define WB_FLUSHER_TASK_NAME    "lfs_flusher"
+#define WB_FLUSHER_TASK_PRIORITY 20
+
+typedef struct {
+    uint32_t addr;      // page address, WB_ADDR_INVALID when free
+    uint32_t seq;       // staging order, pages go to flash oldest first
+    uint32_t filled;    // bytes staged, the page is complete at pageSize
+    UINT64 stagedTick;  // tick of the first prog into the slot
+    uint8_t data[WB_PAGE_MAX]; // 0xFF where nothing is staged, programming 0xFF keeps the flash bits
+} WbSlot;
+
+static WbSlot g_wbSlot[WB_SLOTS];
+static uint32_t g_wbSeq = 0;
+static uint32_t g_wbPageSize = WB_PAGE_MAX;
+static LittlefsWbStat g_wbStat;
+static UINT32 g_wbMux;
+static EVENT_CB_S g_wbEvent;
+static volatile BOOL g_wbHookPending = FALSE;
+static int32_t g_wbError = HDF_SUCCESS; // a flush failed since the last sync, reported by it
+static BOOL g_wbInited = FALSE;
+
+static int32_t WbFlashRead(uint32_t addr, uint8_t *buf, uint32_t size)
+{
+#ifdef LOSCFG_NIOBE407_LITTLEFS_CACHE
+    return LittlefsCacheRead(addr, buf, size);
+#else
+    return W25x_DevRead(W25x_GetDefaultDev(), buf, addr, size);
+#endif
+}
+
+static int32_t WbFlashProg(uint32_t addr, const uint8_t *buf, uint32_t size)
+{
+#ifdef LOSCFG_NIOBE407_LITTLEFS_CACHE
+    return LittlefsCacheProg(addr, buf, size);
+#else
+    return W25x_DevWrite(W25x_GetDefaultDev(), buf, addr, size);
+#endif
+}
+
+static int32_t WbFlashErase(uint32_t addr, uint32_t size)
+{
+#ifdef LOSCFG_NIOBE407_LITTLEFS_CACHE
+    return LittlefsCacheErase(addr, size);
+#else
+    return W25x_DevEraseRange(W25x_GetDefaultDev(), addr, size);
+#endif
+}
+
+/* called with g_wbMux held, a page that fails stays staged for the next flush */
+static int32_t WbFlushSlot(WbSlot *slot, LittlefsWbFlushReason reason)
+{
+    g_wbStat.pagePrograms++;
+    g_wbStat.flushes[reason]++;
+    if (WbFlashProg(slot->addr, slot->data, g_wbPageSize) != HDF_SUCCESS) {
+        g_wbStat.flushErrors++;
+        g_wbError = HDF_FAILURE;
+        HDF_LOGE("%s: page 0x%x not programmed, kept staged\n", __func__, slot->addr);
+        return HDF_FAILURE;
+    }
+    slot->addr = WB_ADDR_INVALID;
+
+    return HDF_SUCCESS;
+}
+
+/*
+ * Program staged pages up to and including seq, oldest first, so flash sees
+ * them in prog order. Stops at the first failure so no later page gets ahead.
+ */
+static int32_t WbFlushUpTo(uint32_t seq, LittlefsWbFlushReason reason)
+{
+    while (1) {
+        WbSlot *oldest = NULL;
+        for (int i = 0; i < WB_SLOTS; i++) {
+            WbSlot *slot = &g_wbSlot[i];
+            if (slot->addr != WB_ADDR_INVALID && (int32_t)(slot->seq - seq) <= 0 &&
+                (oldest == NULL || (int32_t)(slot->seq - oldest->seq) < 0)) {
+                oldest = slot;
+            }
+        }
+        if (oldest == NULL) {
+            return HDF_SUCCESS;
+        }
+        if (WbFlushSlot(oldest, reason) != HDF_SUCCESS) {
+            return HDF_FAILURE;
+        }
+    }
+}
+
+static WbSlot *WbFindSlot(uint32_t pageAddr)
+{
+    for (int i = 0; i < WB_SLOTS; i++) {
+        if (g_wbSlot[i].addr == pageAddr) {
+            return &g_wbSlot[i];
+        }
+    }
+    return NULL;
+}
+
+/* a slot for pageAddr, the oldest staged page goes to flash when none is free */
+static int32_t WbNewSlot(uint32_t pageAddr, WbSlot **out)
+{
+    WbSlot *slot = WbFindSlot(WB_ADDR_INVALID);
+
+    if (slot == NULL) {
+        WbSlot *oldest = &g_wbSlot[0];
+        for (int i = 1; i < WB_SLOTS; i++) {
+            if ((int32_t)(g_wbSlot[i].seq - oldest->seq) < 0) {
+                oldest = &g_wbSlot[i];
+            }
+        }
+        if (WbFlushUpTo(oldest->seq, LITTLEFS_WB_FLUSH_EVICT) != HDF_SUCCESS) {
+            return HDF_FAILURE;
+        }
+        slot = oldest;
+    }
+    slot->addr = pageAddr;
+    slot->seq = g_wbSeq++;
+    slot->filled = 0;
+    slot->stagedTick = LOS_TickCountGet();
+    (void)memset_s(slot->data, sizeof(slot->data), 0xFF, sizeof(slot->data));
+    *out = slot;
+
+    return HDF_SUCCESS;
+}
+
+static void WbFlusherEntry(void)
+{
+    while (1) {
+        (void)LOS_EventRead(&g_wbEvent, WB_EVENT_FLUSH, LOS_WAITMODE_OR | LOS_WAITMODE_CLR,
+            LOS_MS2Tick(WB_FLUSH_MS));
+        (void)LOS_MuxPend(g_wbMux, LOS_WAIT_FOREVER);
+        if (g_wbHookPending) {
+            g_wbHookPending = FALSE;
+            (void)WbFlushUpTo(g_wbSeq - 1, LITTLEFS_WB_FLUSH_HOOK);
+        }
+        /* a failure is latched in g_wbError and the page retried next time, the sync reports it */
+        UINT64 now = LOS_TickCountGet();
+        for (int i = 0; i < WB_SLOTS; i++) {
+            WbSlot *slot = &g_wbSlot[i];
+            if (slot->addr != WB_ADDR_INVALID && now - slot->stagedTick >= LOS_MS2Tick(WB_FLUSH_MS) &&
+                WbFlushUpTo(slot->seq, LITTLEFS_WB_FLUSH_TIMER) != HDF_SUCCESS) {
+                break;
+            }
+        }
+        (void)LOS_MuxPost(g_wbMux);
+    }
+}
+
+int32_t LittlefsWriteBackInit(void)
+{
+    UINT32 taskID;
+    TSK_INIT_PARAM_S stTask = {0};
+    W25xFlashInfo info;
+
+    if (g_wbInited) {
+        return HDF_SUCCESS;
+    }
+    if (W25x_GetFlashInfo(&info) != HDF_SUCCESS || LOS_MuxCreate(&g_wbMux) != LOS_OK ||
+        LOS_EventInit(&g_wbEvent) != LOS_OK) {
+        HDF_LOGE("%s: failed\n", __func__);
+        return HDF_FAILURE;
+    }
+    g_wbPageSize = (info.pageSize < WB_PAGE_MAX) ? info.pageSize : WB_PAGE_MAX;
+    for (int i = 0; i < WB_SLOTS; i++) {
+        g_wbSlot[i].addr = WB_ADDR_INVALID;
+    }
+
+    stTask.pfnTaskEntry = (TSK_ENTRY_FUNC)WbFlusherEntry;
+    stTask.uwStackSize = WB_FLUSHER_STACK_SIZE;
+    stTask.pcName = WB_FLUSHER_TASK_NAME;
+    stTask.usTaskPrio = WB_FLUSHER_TASK_PRIORITY;
+    if (LOS_TaskCreate(&taskID, &stTask) != LOS_OK) {
+        HDF_LOGE("%s: flusher task create failed\n", __func__);
+        return HDF_FAILURE;
+    }
+    g_wbInited = TRUE;
+
+    return HDF_SUCCESS;
+}
+
+int32_t LittlefsWriteBackRead(uint32_t addr, uint8_t *buf, uint32_t size)
+{
+    if (!g_wbInited) {
+        return WbFlashRead(addr, buf, size);
+    }
+
+    (void)LOS_MuxPend(g_wbMux, LOS_WAIT_FOREVER);
+    int32_t ret = WbFlashRead(addr, buf, size);
+    for (int i = 0; i < WB_SLOTS && ret == HDF_SUCCESS; i++) {
+        const WbSlot *slot = &g_wbSlot[i];
+        if (slot->addr == WB_ADDR_INVALID || slot->addr >= addr + size || addr >= slot->addr + g_wbPageSize) {
+            continue;
+        }
+        uint32_t from = (slot->addr > addr) ? slot->addr : addr;
+        uint32_t to = (slot->addr + g_wbPageSize < addr + size) ? (slot->addr + g_wbPageSize) : (addr + size);
+        for (uint32_t a = from; a < to; a++) {
+            buf[a - addr] &= slot->data[a - slot->addr];
+        }
+    }
+    (void)LOS_MuxPost(g_wbMux);
+
+    return ret;
+}
+
+int32_t LittlefsWriteBackProg(uint32_t addr, const uint8_t *buf, uint32_t size)
+{
+    int32_t ret = HDF_SUCCESS;
+
+    if (!g_wbInited) {
+        return WbFlashProg(addr, buf, size);
+    }
+
+    (void)LOS_MuxPend(g_wbMux, LOS_WAIT_FOREVER);
+    g_wbStat.progs++;
+    while (size > 0) {
+        uint32_t pageAddr = addr - (addr % g_wbPageSize);
+        uint32_t off = addr - pageAddr;
+        uint32_t once = (g_wbPageSize - off < size) ? (g_wbPageSize - off) : size;
+        WbSlot *slot = WbFindSlot(pageAddr);
+        if (slot == NULL && WbNewSlot(pageAddr, &slot) != HDF_SUCCESS) {
+            ret = HDF_FAILURE;
+            break;
+        }
+        for (uint32_t i = 0; i < once; i++) {
+            slot->data[off + i] &= buf[i];
+        }
+        slot->filled += once;
+        if (slot->filled >= g_wbPageSize && WbFlushUpTo(slot->seq, LITTLEFS_WB_FLUSH_FULL) != HDF_SUCCESS) {
+            ret = HDF_FAILURE;
+        }
+        addr += once;
+        buf += once;
+        size -= once;
+    }
+    (void)LOS_MuxPost(g_wbMux);
+
+    return ret;
+}
+
+/* staged pages inside the erased range would be wiped on flash anyway, drop them */
+int32_t LittlefsWriteBackErase(uint32_t addr, uint32_t size)
+{
+    if (!g_wbInited) {
+        return WbFlashErase(addr, size);
+    }
+
+    (void)LOS_MuxPend(g_wbMux, LOS_WAIT_FOREVER);
+    for (int i = 0; i < WB_SLOTS; i++) {
+        if (g_wbSlot[i].addr != WB_ADDR_INVALID && g_wbSlot[i].addr >= addr && g_wbSlot[i].addr < addr + size) {
+            g_wbSlot[i].addr = WB_ADDR_INVALID;
+        }
+    }
+    int32_t ret = WbFlashErase(addr, size);
+    (void)LOS_MuxPost(g_wbMux);
+
+    return ret;
+}
+
+int32_t LittlefsWriteBackFlush(void)
+{
+    if (!g_wbInited) {
+        return HDF_SUCCESS;
+    }
+
+    /* pages lost or still staged since the last sync make this one fail too */
+    (void)LOS_MuxPend(g_wbMux, LOS_WAIT_FOREVER);
+    int32_t ret = WbFlushUpTo(g_wbSeq - 1, LITTLEFS_WB_FLUSH_SYNC);
+    if (g_wbError != HDF_SUCCESS) {
+        ret = HDF_FAILURE;
+        g_wbError = HDF_SUCCESS;
+    }
+    (void)LOS_MuxPost(g_wbMux);
+
+    return ret;
+}
+
+/*
+ * For a power voltage detector or similar interrupt: the flusher task
+ * programs everything staged right away instead of at the next interval.
+ */
+void LittlefsWriteBackFlushFromIsr(void)
+{
+    if (!g_wbInited) {
+        return;
+    }
+    g_wbHookPending = TRUE;
+    (void)LOS_EventWrite(&g_wbEvent, WB_EVENT_FLUSH);
+}
+
+void LittlefsWriteBackGetStat(LittlefsWbStat *stat)
+{
+    if (stat != NULL) {
+        (void)memcpy_s(stat, sizeof(*stat), &g_wbStat, sizeof(g_wbStat));
+    }
+}
+
+void LittlefsWriteBackDumpStat(void)
+{
+    HDF_LOGI("littlefs write-back: %u progs in %u page programs, %u failed, "
+        "sync %u full %u evict %u timer %u hook %u\n",
+        g_wbStat.progs, g_wbStat.pagePrograms, g_wbStat.flushErrors, g_wbStat.flushes[LITTLEFS_WB_FLUSH_SYNC],
+        g_wbStat.flushes[LITTLEFS_WB_FLUSH_FULL], g_wbStat.flushes[LITTLEFS_WB_FLUSH_EVICT],
+        g_wbStat.flushes[LITTLEFS_WB_FLUSH_TIMER], g_wbStat.flushes[LITTLEFS_WB_FLUSH_HOOK]);
+}
@@ -0,0 +1,196 @@
+/*
+ * Copyright (c) 2022 Talkweb Co., Ltd.
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Host packer for the read-only asset pack, see fs/littlefs/include/asset_pack.h.
+ *   ./asset_pack assets.bin ca.pem strings/en.txt name=path/to/file ...
+ * An asset is named after its path unless name= is given. Write the output
+ * raw to the w25qxx at LOSCFG_NIOBE407_ASSET_PACK_ADDR.
+ */
+
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "asset_pack.h"
+
+#define ARGV_OUTPUT         1
+#define ARGV_FIRST_ASSET    2
+#define MIN_ARGC            3
+#define MAX_ASSETS          1024
+#define FILL_CHAR           0xFF
+
+typedef struct {
+    const char *path;
+    AssetPackEntry entry;
+} AssetInput;
+
+static AssetInput g_assets[MAX_ASSETS];
+
+static void Usage(void)
+{
+    printf("Params error:\r\nFor usage example: ./asset_pack assets.bin ca.pem name=path/to/file ...\r\n");
+}
+
+/* same as lfs_crc, bit by bit */
+static uint32_t Crc32(uint32_t crc, const void *buffer, size_t size)
+{
+    const uint8_t *data = buffer;
+    for (size_t i = 0; i < size; i++) {
+        crc ^= data[i];
+        for (int bit = 0; bit < 8; bit++) {
+            crc = (crc >> 1) ^ (0xEDB88320 & (0 - (crc & 1)));
+        }
+    }
+    return crc;
+}
+
+static int CompareAsset(const void *a, const void *b)
+{
+    return strcmp(((const AssetInput *)a)->entry.name, ((const AssetInput *)b)->entry.name);
+}
+
+static int ParseAsset(const char *arg, AssetInput *asset)
+{
+    const char *eq = strchr(arg, '=');
+    const char *name = arg;
+    size_t nameLen = strlen(arg);
+
+    if (eq != NULL) {
+        nameLen = eq - arg;
+        asset->path = eq + 1;
+    } else {
+        asset->path = arg;
+    }
+    if (nameLen == 0 || nameLen >= ASSET_NAME_MAX) {
+        printf("asset_pack fail! name of %s must be 1..%d chars\r\n", arg, ASSET_NAME_MAX - 1);
+        return -1;
+    }
+    memset(&asset->entry, 0, sizeof(asset->entry));
+    memcpy(asset->entry.name, name, nameLen);
+    return 0;
+}
+
+static int WriteFill(FILE *out, long to)
+{
+    while (ftell(out) < to) {
+        if (fputc(FILL_CHAR, out) == EOF) {
+            return -1;
+        }
+    }
+    return 0;
+}
+
+/* copy one asset to the output, filling in offset, size and crc */
+static int CopyAsset(FILE *out, AssetInput *asset)
+{
+    unsigned char buffer[1024];
+    size_t len;
+    FILE *in = fopen(asset->path, "rb");
+
+    if (in == NULL) {
+        printf("asset_pack fail! because open %s fail!\r\n", asset->path);
+        return -1;
+    }
+    long offset = (ftell(out) + ASSET_DATA_ALIGN - 1) / ASSET_DATA_ALIGN * ASSET_DATA_ALIGN;
+    if (WriteFill(out, offset) != 0) {
+        fclose(in);
+        return -1;
+    }
+    asset->entry.offset = (uint32_t)offset;
+    asset->entry.crc = 0xFFFFFFFF;
+    while ((len = fread(buffer, 1, sizeof(buffer), in)) > 0) {
+        if (fwrite(buffer, 1, len, out) != len) {
+            fclose(in);
+            return -1;
+        }
+        asset->entry.size += len;
+        asset->entry.crc = Crc32(asset->entry.crc, buffer, len);
+    }
+    fclose(in);
+    return 0;
+}
+
+static int WritePack(FILE *out, int count)
+{
+    AssetPackHeader header = {0};
+    long indexEnd = sizeof(header) + count * sizeof(AssetPackEntry);
+
+    if (WriteFill(out, indexEnd) != 0) {   // index goes in once the offsets are known
+        return -1;
+    }
+    for (int i = 0; i < count; i++) {
+        if (CopyAsset(out, &g_assets[i]) != 0) {
+            return -1;
+        }
+    }
+    header.magic = ASSET_PACK_MAGIC;
+    header.version = ASSET_PACK_VERSION;
+    header.count = (uint16_t)count;
+    header.size = (uint32_t)ftell(out);
+    header.indexCrc = 0xFFFFFFFF;
+    for (int i = 0; i < count; i++) {
+        header.indexCrc = Crc32(header.indexCrc, &g_assets[i].entry, sizeof(AssetPackEntry));
+    }
+    header.crc = Crc32(0xFFFFFFFF, &header, offsetof(AssetPackHeader, crc));
+
+    if (fseek(out, 0, SEEK_SET) != 0 || fwrite(&header, sizeof(header), 1, out) != 1) {
+        return -1;
+    }
+    for (int i = 0; i < count; i++) {
+        if (fwrite(&g_assets[i].entry, sizeof(AssetPackEntry), 1, out) != 1) {
+            return -1;
+        }
+    }
+    printf("asset_pack %d assets, %u bytes to pack\r\n", count, header.size);
+    return 0;
+}
+
+int main(int argc, char *argv[])
+{
+    int count = argc - ARGV_FIRST_ASSET;
+
+    if (argc < MIN_ARGC || count > MAX_ASSETS) {
+        Usage();
+        return -1;
+    }
+    for (int i = 0; i < count; i++) {
+        if (ParseAsset(argv[ARGV_FIRST_ASSET + i], &g_assets[i]) != 0) {
+            return -1;
+        }
+    }
+    qsort(g_assets, count, sizeof(g_assets[0]), CompareAsset);
+    for (int i = 1; i < count; i++) {
+        if (strcmp(g_assets[i - 1].entry.name, g_assets[i].entry.name) == 0) {
+            printf("asset_pack fail! %s given twice\r\n", g_assets[i].entry.name);
+            return -1;
+        }
+    }
+
+    FILE *out = fopen(argv[ARGV_OUTPUT], "wb+");
+    if (out == NULL) {
+        printf("asset_pack fail! because open %s fail!\r\n", argv[ARGV_OUTPUT]);
+        return -1;
+    }
+    int ret = WritePack(out, count);
+    fclose(out);
+    if (ret != 0) {
+        printf("asset_pack fail! because write %s fail!\r\n", argv[ARGV_OUTPUT]);
+        remove(argv[ARGV_OUTPUT]);
+        return -1;
+    }
+    printf("asset_pack to %s success!\r\n", argv[ARGV_OUTPUT]);
+    return 0;
+}
@@ -0,0 +1,354 @@
+/*
+ * Copyright (c) 2022 Talkweb Co., Ltd.
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Host decoder of the binary log, see drivers/uart/include/binlog.h.
+ *   ./binlog_decode [-t] OHOS_Image.elf [capture.bin|/dev/ttyUSB0]
+ * Reads the console stream from the file, or stdin without one, formats the
+ * frames with the strings of the elf and passes the text between them
+ * through. The elf must be the one running, a frame with a format address
+ * that isn't a string in it is passed through as text. -t puts the time in
+ * front of printf frames too, hilog records always have it.
+ */
+
+#include <elf.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "binlog.h"
+
+#define ARGV_MIN            2
+#define MAX_SECTIONS        64
+#define SPEC_MAX            32
+#define LEVEL_SHIFT         4
+#define COUNT_MASK          0x0F
+#define WORD_SIZE           4
+#define MS_PER_SECOND       1000
+
+typedef struct {
+    uint64_t addr;
+    uint64_t size;
+    unsigned char *data;
+} ElfSection;
+
+static ElfSection g_sections[MAX_SECTIONS];
+static int g_sectionCount = 0;
+static int g_showTime = 0;
+static uint32_t g_frames = 0;
+static uint32_t g_badFrames = 0;
+
+static void Usage(void)
+{
+    printf("Params error:\r\nFor usage example: ./binlog_decode [-t] OHOS_Image.elf [capture.bin]\r\n");
+}
+
+static int AddSection(FILE *elf, uint64_t addr, uint64_t offset, uint64_t size)
+{
+    ElfSection *section = &g_sections[g_sectionCount];
+
+    if (g_sectionCount == MAX_SECTIONS || size == 0) {
+        return 0;
+    }
+    section->data = malloc(size);
+    if (section->data == NULL || fseek(elf, (long)offset, SEEK_SET) != 0 ||
+        fread(section->data, 1, size, elf) != size) {
+        free(section->data);
+        return -1;
+    }
+    section->addr = addr;
+    section->size = size;
+    g_sectionCount++;
+    return 0;
+}
+
+/* keep the allocated sections with contents, that's where the format strings are */
+static int LoadElf(const char *path)
+{
+    unsigned char ident[EI_NIDENT];
+    int ret = -1;
+    FILE *elf = fopen(path, "rb");
+
+    if (elf == NULL) {
+        printf("binlog_decode fail! because open %s fail!\r\n", path);
+        return -1;
+    }
+    if (fread(ident, 1, sizeof(ident), elf) != sizeof(ident) || memcmp(ident, ELFMAG, SELFMAG) != 0 ||
+        ident[EI_DATA] != ELFDATA2LSB) {
+        printf("binlog_decode fail! %s isn't a little endian elf\r\n", path);
+        fclose(elf);
+        return -1;
+    }
+    rewind(elf);
+    if (ident[EI_CLASS] == ELFCLASS32) {
+        Elf32_Ehdr ehdr;
+        Elf32_Shdr shdr;
+        ret = (fread(&ehdr, sizeof(ehdr), 1, elf) == 1) ? 0 : -1;
+        for (int i = 0; ret == 0 && i < ehdr.e_shnum; i++) {
+            if (fseek(elf, (long)(ehdr.e_shoff + i * ehdr.e_shentsize), SEEK_SET) != 0 ||
+                fread(&shdr, sizeof(shdr), 1, elf) != 1) {
+                ret = -1;
+            } else if ((shdr.sh_flags & SHF_ALLOC) != 0 && shdr.sh_type == SHT_PROGBITS) {
+                ret = AddSection(elf, shdr.sh_addr, shdr.sh_offset, shdr.sh_size);
+            }
+        }
+    } else {    // host builds, for trying the decoder out
+        Elf64_Ehdr ehdr;
+        Elf64_Shdr shdr;
+        ret = (fread(&ehdr, sizeof(ehdr), 1, elf) == 1) ? 0 : -1;
+        for (int i = 0; ret == 0 && i < ehdr.e_shnum; i++) {
+            if (fseek(elf, (long)(ehdr.e_shoff + i * ehdr.e_shentsize), SEEK_SET) != 0 ||
+                fread(&shdr, sizeof(shdr), 1, elf) != 1) {
+                ret = -1;
+            } else if ((shdr.sh_flags & SHF_ALLOC) != 0 && shdr.sh_type == SHT_PROGBITS) {
+                ret = AddSection(elf, shdr.sh_addr, shdr.sh_offset, shdr.sh_size);
+            }
+        }
+    }
+    fclose(elf);
+    if (ret != 0 || g_sectionCount == 0) {
+        printf("binlog_decode fail! because read %s fail!\r\n", path);
+        return -1;
+    }
+    return 0;
+}
+
+/* the string at addr in the elf, NULL if there is none */
+static const char *ElfString(uint32_t addr)
+{
+    for (int i = 0; i < g_sectionCount; i++) {
+        ElfSection *section = &g_sections[i];
+        if (addr < section->addr || addr - section->addr >= section->size) {
+            continue;
+        }
+        uint64_t offset = addr - section->addr;
+        if (memchr(section->data + offset, 0, section->size - offset) == NULL) {
+            return NULL;
+        }
+        return (const char *)section->data + offset;
+    }
+    return NULL;
+}
+
+static uint32_t NextWord(const BinLogFrame *frame, uint32_t count, uint32_t *used)
+{
+    if (*used >= count) {
+        (*used)++;
+        return 0;
+    }
+    return frame->args[(*used)++];
+}
+
+static uint64_t NextWide(const BinLogFrame *frame, uint32_t count, uint32_t *used)
+{
+    uint64_t low = NextWord(frame, count, used);
+    uint64_t high = NextWord(frame, count, used);
+    return low | (high << 32);
+}
+
+/* one conversion, fmt points past the '%', same rules as BinLogArg on the target */
+static const char *PrintArg(const char *fmt, const BinLogFrame *frame, uint32_t count, uint32_t *used)
+{
+    char spec[SPEC_MAX] = "%";
+    size_t len = 1;
+    uint32_t longs = 0;
+    const char *p = fmt;
+
+    p += strspn(p, "-+ #0");
+    p += strspn(p, "0123456789.");
+    if ((size_t)(p - fmt) >= SPEC_MAX - 4) {
+        fputs("%", stdout);
+        return fmt;
+    }
+    memcpy(spec + len, fmt, p - fmt);
+    len += p - fmt;
+    while (*p == 'l' || *p == 'h' || *p == 'z' || *p == 't' || *p == 'j' || *p == 'L') {
+        longs += (*p == 'l') ? 1 : ((*p == 'j') ? 2 : 0);
+        p++;
+    }
+    if (*p == '\0') {
+        fputs(spec, stdout);
+        return p;
+    }
+    char conv = *p++;
+    switch (conv) {
+        case '%':
+            putchar('%');
+            break;
+        case 'd': case 'i':
+        case 'u': case 'x': case 'X': case 'o': case 'c':
+            if (longs >= 2) {
+                uint64_t value = NextWide(frame, count, used);
+                spec[len++] = 'l';
+                spec[len++] = 'l';
+                spec[len++] = conv;
+                printf(spec, (conv == 'd' || conv == 'i') ? (long long)value : (unsigned long long)value);
+            } else {
+                uint32_t value = NextWord(frame, count, used);
+                spec[len++] = conv;
+                printf(spec, (conv == 'd' || conv == 'i') ? (int)(int32_t)value : (unsigned int)value);
+            }
+            break;
+        case 'f': case 'F': case 'e': case 'E': case 'g': case 'G': case 'a': case 'A': {
+            uint64_t bits = NextWide(frame, count, used);
+            double value;
+            memcpy(&value, &bits, sizeof(value));
+            spec[len++] = conv;
+            printf(spec, value);
+            break;
+        }
+        case 'p':
+            printf("0x%x", NextWord(frame, count, used));
+            break;
+        case 's': {
+            uint32_t addr = NextWord(frame, count, used);
+            const char *s = ElfString(addr);
+            spec[len++] = 's';
+            if (s != NULL) {
+                printf(spec, s);
+            } else {
+                printf("(0x%08x)", addr);
+            }
+            break;
+        }
+        default:
+            fputs(spec, stdout);
+            putchar(conv);
+            break;
+    }
+    return p;
+}
+
+static void PrintFrame(const BinLogFrame *frame, const char *fmt)
+{
+    static const char levels[] = "?DIWEF";
+    uint32_t level = frame->info >> LEVEL_SHIFT;
+    uint32_t count = frame->info & COUNT_MASK;
+    uint32_t used = 0;
+
+    if (level != BINLOG_LEVEL_PRINTF) {
+        printf("%u.%03u %c %u: ", frame->time / MS_PER_SECOND, frame->time % MS_PER_SECOND,
+            (level < sizeof(levels) - 1) ? levels[level] : '?', frame->module);
+    } else if (g_showTime) {
+        printf("[%u.%03u] ", frame->time / MS_PER_SECOND, frame->time % MS_PER_SECOND);
+    }
+    while (*fmt != '\0') {
+        if (*fmt != '%') {
+            putchar(*fmt++);
+            continue;
+        }
+        fmt = PrintArg(fmt + 1, frame, count, &used);
+    }
+    if (level != BINLOG_LEVEL_PRINTF) {
+        putchar('\n');  // hilog formats have no line end
+    }
+    if (used > count) {
+        fprintf(stderr, "binlog_decode: %u arguments sent for \"%s\"\n", count, ElfString(frame->fmt));
+    }
+    fflush(stdout);
+}
+
+/* frame size if pend starts with a whole valid frame, 0 if it needs more bytes, -1 if it's text */
+static int CheckFrame(const unsigned char *pend, size_t len, const char **fmt)
+{
+    BinLogFrame frame;
+    uint8_t sum = 0;
+
+    if (pend[0] != BINLOG_MAGIC) {
+        return -1;
+    }
+    if (len < BINLOG_HEAD_SIZE) {
+        return 0;
+    }
+    size_t size = BINLOG_HEAD_SIZE + (pend[1] & COUNT_MASK) * WORD_SIZE;
+    if (len < size) {
+        return 0;
+    }
+    for (size_t i = 0; i < size; i++) {
+        sum += pend[i];
+    }
+    memcpy(&frame, pend, size);
+    *fmt = ElfString(frame.fmt);
+    return (sum == 0 && *fmt != NULL) ? (int)size : -1;
+}
+
+static void Decode(FILE *in)
+{
+    unsigned char pend[sizeof(BinLogFrame)];
+    size_t len = 0;
+    int ch;
+    int eof = 0;
+
+    while (!eof || len > 0) {
+        if (!eof && (len == 0 || pend[0] == BINLOG_MAGIC)) {
+            ch = fgetc(in);
+            if (ch == EOF) {
+                eof = 1;
+            } else {
+                pend[len++] = (unsigned char)ch;
+            }
+        }
+        const char *fmt = NULL;
+        int size = (len > 0) ? CheckFrame(pend, len, &fmt) : 0;
+        if (size > 0) {
+            BinLogFrame frame;
+            memcpy(&frame, pend, size);
+            PrintFrame(&frame, fmt);
+            g_frames++;
+            len -= size;
+            memmove(pend, pend + size, len);
+        } else if (size < 0 || (eof && len > 0)) {
+            /* text, or the start of a frame that turned out not to be one */
+            g_badFrames += (pend[0] == BINLOG_MAGIC) ? 1 : 0;
+            putchar(pend[0]);
+            if (pend[0] == '\n') {
+                fflush(stdout);
+            }
+            len--;
+            memmove(pend, pend + 1, len);
+        }
+    }
+    fflush(stdout);
+}
+
+int main(int argc, char *argv[])
+{
+    int arg = 1;
+    FILE *in = stdin;
+
+    if (arg < argc && strcmp(argv[arg], "-t") == 0) {
+        g_showTime = 1;
+        arg++;
+    }
+    if (argc - arg < ARGV_MIN - 1 || argc - arg > ARGV_MIN) {
+        Usage();
+        return -1;
+    }
+    if (LoadElf(argv[arg]) != 0) {
+        return -1;
+    }
+    if (argc - arg == ARGV_MIN) {
+        in = fopen(argv[arg + 1], "rb");
+        if (in == NULL) {
+            printf("binlog_decode fail! because open %s fail!\r\n", argv[arg + 1]);
+            return -1;
+        }
+    }
+    Decode(in);
+    if (in != stdin) {
+        fclose(in);
+    }
+    fprintf(stderr, "binlog_decode %u frames, %u bytes like a frame start skipped\n", g_frames, g_badFrames);
+    return 0;
+}
@@ -0,0 +1,299 @@
+/*
+ * Copyright (c) 2022 Talkweb Co., Ltd.
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "w25qxx.h"
+#include "w25q_sim.h"
+
+#define BENCH_BUF_SIZE          0x10000
+#define BENCH_READ_BASE         (g_benchBase + 0x100000)
+#define BENCH_WRITE_BASE        (g_benchBase + 0x200000)
+#define BENCH_ERASE_BASE        (g_benchBase + 0x400000)
+#define BENCH_3BYTE_LIMIT       0x1000000
+#define BENCH_JEDEC_ID_BASE     0xEF4000    // W25QxxJV, the low byte is log2 of the capacity
+#define BENCH_REGION_SIZE       0x100000
+#define BENCH_UNALIGNED_OFFSET  100
+#define BENCH_NS_PER_SEC        1e9
+#define BENCH_BYTES_PER_KB      1024.0
+#define BENCH_PERCENT           100.0
+
+typedef struct {
+    const char *name;
+    uint32_t opBytes;
+    uint32_t ops;
+    int (*prepare)(W25xDev *dev, uint32_t opBytes, uint32_t ops);
+    int (*run)(W25xDev *dev, uint32_t index, uint32_t opBytes);
+    int (*check)(W25xDev *dev, uint32_t opBytes, uint32_t ops);
+} BenchCase;
+
+static uint8_t g_buf[BENCH_BUF_SIZE];
+static uint8_t g_verify[BENCH_BUF_SIZE];
+static int g_csv = 0;
+static uint32_t g_benchBase = 0;    // above 16MB on larger parts, so 4-byte addressing is exercised
+
+static uint8_t Pattern(uint32_t addr)
+{
+    return (uint8_t)(addr * 31 + (addr >> 8));
+}
+
+static uint32_t WriteAddr(uint32_t index, uint32_t opBytes, uint32_t offset)
+{
+    return BENCH_WRITE_BASE + offset + index * opBytes;
+}
+
+static int ReadRun(W25xDev *dev, uint32_t index, uint32_t opBytes)
+{
+    uint32_t addr = BENCH_READ_BASE + (index * opBytes) % BENCH_REGION_SIZE;
+    return W25x_DevRead(dev, g_buf, addr, opBytes);
+}
+
+static int WritePrepare(W25xDev *dev, uint32_t opBytes, uint32_t ops)
+{
+    uint32_t size = opBytes * ops + BENCH_UNALIGNED_OFFSET;
+    size = (size + 0xFFF) & ~0xFFFu;
+    return W25x_DevEraseRange(dev, BENCH_WRITE_BASE, size);
+}
+
+static int WriteAt(W25xDev *dev, uint32_t addr, uint32_t opBytes)
+{
+    for (uint32_t i = 0; i < opBytes; i++) {
+        g_buf[i] = Pattern(addr + i);
+    }
+    return W25x_DevWrite(dev, g_buf, addr, opBytes);
+}
+
+static int WriteRun(W25xDev *dev, uint32_t index, uint32_t opBytes)
+{
+    return WriteAt(dev, WriteAddr(index, opBytes, 0), opBytes);
+}
+
+static int WriteUnalignedRun(W25xDev *dev, uint32_t index, uint32_t opBytes)
+{
+    return WriteAt(dev, WriteAddr(index, opBytes, BENCH_UNALIGNED_OFFSET), opBytes);
+}
+
+static int VerifyFrom(W25xDev *dev, uint32_t base, uint32_t total)
+{
+    for (uint32_t done = 0; done < total;) {
+        uint32_t once = (total - done > BENCH_BUF_SIZE) ? BENCH_BUF_SIZE : total - done;
+        if (W25x_DevRead(dev, g_verify, base + done, once) != HDF_SUCCESS) {
+            return -1;
+        }
+        for (uint32_t i = 0; i < once; i++) {
+            /* the array too, a wrong address width reads back what it wrote at the wrong place */
+            if (g_verify[i] != Pattern(base + done + i) || W25qSim_Memory()[base + done + i] != g_verify[i]) {
+                fprintf(stderr, "verify: mismatch at 0x%x\n", base + done + i);
+                return -1;
+            }
+        }
+        done += once;
+    }
+    return 0;
+}
+
+static int WriteCheck(W25xDev *dev, uint32_t opBytes, uint32_t ops)
+{
+    return VerifyFrom(dev, BENCH_WRITE_BASE, opBytes * ops);
+}
+
+static int WriteUnalignedCheck(W25xDev *dev, uint32_t opBytes, uint32_t ops)
+{
+    return VerifyFrom(dev, BENCH_WRITE_BASE + BENCH_UNALIGNED_OFFSET, opBytes * ops);
+}
+
+static int SectorEraseRun(W25xDev *dev, uint32_t index, uint32_t opBytes)
+{
+    return W25x_DevSectorErase(dev, BENCH_ERASE_BASE + index * opBytes);
+}
+
+static int EraseRangeRun(W25xDev *dev, uint32_t index, uint32_t opBytes)
+{
+    return W25x_DevEraseRange(dev, BENCH_ERASE_BASE + index * opBytes, opBytes);
+}
+
+/* 0x3000 + 0x22000: 4KB sectors up to the 32KB boundary, then 32KB/64KB blocks, then sectors */
+static int EraseRangeMixedRun(W25xDev *dev, uint32_t index, uint32_t opBytes)
+{
+    return W25x_DevEraseRange(dev, BENCH_ERASE_BASE + index * BENCH_REGION_SIZE / 4 + 0x3000, opBytes);
+}
+
+static int EraseCheck(W25xDev *dev, uint32_t opBytes, uint32_t ops)
+{
+    const uint8_t *mem = W25qSim_Memory();
+    (void)dev;
+    for (uint32_t i = 0; i < opBytes * ops && i < BENCH_REGION_SIZE; i++) {
+        if (mem[BENCH_ERASE_BASE + i] != 0xFF) {
+            fprintf(stderr, "verify: 0x%x not erased\n", BENCH_ERASE_BASE + i);
+            return -1;
+        }
+    }
+    return 0;
+}
+
+static int ErasePrepare(W25xDev *dev, uint32_t opBytes, uint32_t ops)
+{
+    /* dirty the area so the erase has something to do */
+    memset(W25qSim_Memory() + BENCH_ERASE_BASE, 0, BENCH_REGION_SIZE);
+    (void)dev;
+    (void)opBytes;
+    (void)ops;
+    return 0;
+}
+
+static const BenchCase g_cases[] = {
+    {"read_16", 16, 1000, NULL, ReadRun, NULL},
+    {"read_256", 256, 1000, NULL, ReadRun, NULL},
+    {"read_4k", 0x1000, 256, NULL, ReadRun, NULL},
+    {"read_64k", 0x10000, 16, NULL, ReadRun, NULL},
+    {"page_write_256", 256, 256, WritePrepare, WriteRun, WriteCheck},
+    {"write_4k_unaligned", 0x1000, 64, WritePrepare, WriteUnalignedRun, WriteUnalignedCheck},
+    {"write_64k", 0x10000, 8, WritePrepare, WriteRun, WriteCheck},
+    {"sector_erase_4k", 0x1000, 16, ErasePrepare, SectorEraseRun, EraseCheck},
+    {"erase_range_64k", 0x10000, 8, ErasePrepare, EraseRangeRun, EraseCheck},
+    {"erase_range_mixed", 0x22000, 4, ErasePrepare, EraseRangeMixedRun, NULL},
+};
+
+static void PrintHeader(void)
+{
+    if (g_csv) {
+        printf("case,ops,op_bytes,elapsed_us,kb_per_s,xfers_per_op,frames_per_op,bus_bytes_per_op,"
+            "polls_per_op,sleep_pct\n");
+    } else {
+        printf("%-20s %6s %8s %12s %10s %9s %9s %10s %9s %7s\n", "case", "ops", "op_bytes", "elapsed_us",
+            "KB/s", "xfer/op", "frame/op", "busB/op", "poll/op", "sleep%");
+    }
+}
+
+static void PrintResult(const BenchCase *c, uint64_t elapsedNs, const W25qSimStats *st)
+{
+    double ops = c->ops;
+    double secs = elapsedNs / BENCH_NS_PER_SEC;
+    double kbps = (secs > 0) ? (double)c->opBytes * c->ops / BENCH_BYTES_PER_KB / secs : 0;
+    double sleepPct = (elapsedNs > 0) ? st->sleepNs * BENCH_PERCENT / elapsedNs : 0;
+    const char *fmt = g_csv ? "%s,%u,%u,%.1f,%.1f,%.2f,%.2f,%.1f,%.2f,%.1f\n" :
+        "%-20s %6u %8u %12.1f %10.1f %9.2f %9.2f %10.1f %9.2f %7.1f\n";
+
+    printf(fmt, c->name, c->ops, c->opBytes, elapsedNs / 1000.0, kbps, st->xfers / ops, st->frames / ops,
+        st->bytes / ops, st->statusPolls / ops, sleepPct);
+}
+
+static int RunCase(W25xDev *dev, const BenchCase *c)
+{
+    W25qSimStats st;
+
+    if (c->prepare != NULL && c->prepare(dev, c->opBytes, c->ops) != 0) {
+        fprintf(stderr, "%s: prepare failed\n", c->name);
+        return -1;
+    }
+    W25qSim_ResetStats();
+    uint64_t start = W25qSim_NowNs();
+    for (uint32_t i = 0; i < c->ops; i++) {
+        if (c->run(dev, i, c->opBytes) != HDF_SUCCESS) {
+            fprintf(stderr, "%s: op %u failed\n", c->name, i);
+            return -1;
+        }
+    }
+    uint64_t elapsed = W25qSim_NowNs() - start;
+    W25qSim_GetStats(&st);
+    PrintResult(c, elapsed, &st);
+
+    if (st.protocolErrors != 0 || st.unerasedPrograms != 0) {
+        fprintf(stderr, "%s: %llu protocol errors, %llu programs over unerased data\n", c->name,
+            (unsigned long long)st.protocolErrors, (unsigned long long)st.unerasedPrograms);
+        return -1;
+    }
+    if (c->check != NULL && c->check(dev, c->opBytes, c->ops) != 0) {
+        fprintf(stderr, "%s: verify failed\n", c->name);
+        return -1;
+    }
+    return 0;
+}
+
+static void Usage(const char *prog)
+{
+    printf("usage: %s [-b baud_index] [-x xfer_overhead_ns] [-y byte_overhead_ns] [-p page_program_us]\n"
+        "          [-s sector_erase_us] [-k block64_erase_us] [-m capacity] [-f case] [-n] [-c] [-l] [-v]\n"
+        "  -m  flash size in bytes, power of two, 0x2000000 for a W25Q256\n"
+        "  -n  flash without sfdp, the driver falls back to the JEDEC ID\n"
+        "  -c  csv output\n"
+        "  -l  dump the driver latency histograms at the end\n"
+        "  -v  log every rejected flash command\n", prog);
+}
+
+int main(int argc, char **argv)
+{
+    W25qSimConfig cfg;
+    const char *filter = NULL;
+    int dumpLatency = 0;
+    int failed = 0;
+    int opt;
+
+    W25qSim_DefaultConfig(&cfg);
+    while ((opt = getopt(argc, argv, "b:x:y:p:s:k:m:f:nclvh")) != -1) {
+        switch (opt) {
+            case 'b': cfg.baudIndex = strtoul(optarg, NULL, 0); break;
+            case 'x': cfg.xferOverheadNs = strtoul(optarg, NULL, 0); break;
+            case 'y': cfg.byteOverheadNs = strtoul(optarg, NULL, 0); break;
+            case 'p': cfg.tPageProgramUs = strtoul(optarg, NULL, 0); break;
+            case 's': cfg.tSectorEraseUs = strtoul(optarg, NULL, 0); break;
+            case 'k': cfg.tBlock64EraseUs = strtoul(optarg, NULL, 0); break;
+            case 'm': cfg.capacity = strtoul(optarg, NULL, 0); break;
+            case 'n': cfg.sfdp = 0; break;
+            case 'f': filter = optarg; break;
+            case 'c': g_csv = 1; break;
+            case 'l': dumpLatency = 1; break;
+            case 'v': W25qSim_SetVerbose(1); break;
+            default: Usage(argv[0]); return (opt == 'h') ? 0 : 1;
+        }
+    }
+
+    cfg.jedecId = BENCH_JEDEC_ID_BASE | (uint32_t)__builtin_ctz(cfg.capacity);
+    g_benchBase = (cfg.capacity > BENCH_3BYTE_LIMIT) ? BENCH_3BYTE_LIMIT : 0;
+    if (W25qSim_Init(&cfg) != 0 || W25x_InitSpiFlash(0, 0) != HDF_SUCCESS) {
+        fprintf(stderr, "flash init failed\n");
+        return 1;
+    }
+    W25xDev *dev = W25x_GetDefaultDev();
+    W25xFlashInfo info;
+    if (W25x_DevReadID(dev) != (cfg.jedecId & 0xFFFF) || W25x_DevGetInfo(dev, &info) != HDF_SUCCESS ||
+        info.capacity != cfg.capacity) {
+        fprintf(stderr, "unexpected flash id 0x%x or geometry\n", W25x_DevReadID(dev));
+        return 1;
+    }
+    /* the read area holds data so reads are not all 0xFF */
+    for (uint32_t i = 0; i < BENCH_REGION_SIZE; i++) {
+        W25qSim_Memory()[BENCH_READ_BASE + i] = Pattern(i);
+    }
+
+    PrintHeader();
+    for (size_t i = 0; i < sizeof(g_cases) / sizeof(g_cases[0]); i++) {
+        if (filter != NULL && strcmp(filter, g_cases[i].name) != 0) {
+            continue;
+        }
+        if (RunCase(dev, &g_cases[i]) != 0) {
+            failed++;
+        }
+    }
+    if (dumpLatency) {
+        W25x_DumpLatencyStat();
+    }
+
+    W25x_DeInitSpiFlash();
+    W25qSim_Deinit();
+    return (failed != 0) ? 1 : 0;
+}
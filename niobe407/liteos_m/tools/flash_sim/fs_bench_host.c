@@ -0,0 +1,193 @@
+/*
+ * Copyright (c) 2022 Talkweb Co., Ltd.
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+/*
+ * Host build of applications/403_file_fs_bench: littlefs with the board's
+ * block device glue over the w25qxx driver and the simulated flash. Times
+ * are simulated flash time, so runs are repeatable and comparable in ci.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "lfs.h"
+#include "littlefs.h"
+#include "w25qxx.h"
+#include "w25q_sim.h"
+#include "fs_bench.h"
+#ifdef LOSCFG_NIOBE407_LITTLEFS_CACHE
+#include "littlefs_cache.h"
+#endif
+
+#define HOST_PARTITION      0x800000
+#define HOST_BLOCK_SIZE     4096
+#define HOST_BLOCK_COUNT    256
+#define HOST_RW_SIZE        64
+#define HOST_LOOKAHEAD      64
+#define HOST_BLOCK_CYCLES   16
+#define HOST_MAX_FILES      4
+#define HOST_LABEL_MAX      32
+#define HOST_NS_PER_US      1000
+
+static lfs_t g_lfs;
+static lfs_file_t g_files[HOST_MAX_FILES];
+static int g_fileUsed[HOST_MAX_FILES];
+static const uint32_t g_cacheSizes[] = {64, 256, 1024};
+
+static int HostOpen(const char *path, int mode)
+{
+    static const int flags[] = {
+        [FS_BENCH_RDONLY] = LFS_O_RDONLY,
+        [FS_BENCH_RDWR] = LFS_O_RDWR,
+        [FS_BENCH_CREATE] = LFS_O_RDWR | LFS_O_CREAT | LFS_O_TRUNC,
+        [FS_BENCH_APPEND] = LFS_O_RDWR | LFS_O_CREAT | LFS_O_APPEND,
+    };
+    for (int fd = 0; fd < HOST_MAX_FILES; fd++) {
+        if (!g_fileUsed[fd]) {
+            if (lfs_file_open(&g_lfs, &g_files[fd], path, flags[mode]) != 0) {
+                return -1;
+            }
+            g_fileUsed[fd] = 1;
+            return fd;
+        }
+    }
+    return -1;
+}
+
+static int HostClose(int fd)
+{
+    g_fileUsed[fd] = 0;
+    return lfs_file_close(&g_lfs, &g_files[fd]);
+}
+
+static int HostRead(int fd, void *buf, uint32_t size)
+{
+    return lfs_file_read(&g_lfs, &g_files[fd], buf, size);
+}
+
+static int HostWrite(int fd, const void *buf, uint32_t size)
+{
+    return lfs_file_write(&g_lfs, &g_files[fd], buf, size);
+}
+
+static int HostSeek(int fd, uint32_t offset)
+{
+    return (lfs_file_seek(&g_lfs, &g_files[fd], offset, LFS_SEEK_SET) == (lfs_soff_t)offset) ? 0 : -1;
+}
+
+static int HostSync(int fd)
+{
+    return lfs_file_sync(&g_lfs, &g_files[fd]);
+}
+
+static int HostUnlink(const char *path)
+{
+    return lfs_remove(&g_lfs, path);
+}
+
+static uint64_t HostNowUs(void)
+{
+    return W25qSim_NowNs() / HOST_NS_PER_US;
+}
+
+static const FsBenchOps g_hostOps = {
+    .open = HostOpen,
+    .close = HostClose,
+    .read = HostRead,
+    .write = HostWrite,
+    .seek = HostSeek,
+    .sync = HostSync,
+    .unlink = HostUnlink,
+    .nowUs = HostNowUs,
+};
+
+/* format and mount the partition with one lfs cache size, then run every case */
+static int RunCacheSize(uint32_t cacheSize)
+{
+    char label[HOST_LABEL_MAX];
+    struct lfs_config cfg = {
+        .context = (void *)(uintptr_t)HOST_PARTITION,
+        .read = LittlefsRead,
+        .prog = LittlefsProg,
+        .erase = LittlefsErase,
+        .sync = LittlefsSync,
+        .read_size = HOST_RW_SIZE,
+        .prog_size = HOST_RW_SIZE,
+        .block_size = HOST_BLOCK_SIZE,
+        .block_count = HOST_BLOCK_COUNT,
+        .cache_size = cacheSize,
+        .lookahead_size = HOST_LOOKAHEAD,
+        .block_cycles = HOST_BLOCK_CYCLES,
+    };
+
+    if (lfs_format(&g_lfs, &cfg) != 0 || lfs_mount(&g_lfs, &cfg) != 0) {
+        fprintf(stderr, "lfs cache %u: format or mount failed\n", cacheSize);
+        return 1;
+    }
+    (void)snprintf(label, sizeof(label), "cache%u", cacheSize);
+    int failed = FsBenchRun(&g_hostOps, "", label);
+    (void)lfs_unmount(&g_lfs);
+    return failed;
+}
+
+static void Usage(const char *prog)
+{
+    printf("usage: %s [-s lfs_cache_size] [-v]\n"
+        "  -s  run one lfs cache size instead of 64, 256 and 1024\n"
+        "  -v  log every rejected flash command\n", prog);
+}
+
+int main(int argc, char **argv)
+{
+    W25qSimConfig simCfg;
+    uint32_t cacheSize = 0;
+    int failed = 0;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "s:vh")) != -1) {
+        switch (opt) {
+            case 's': cacheSize = strtoul(optarg, NULL, 0); break;
+            case 'v': W25qSim_SetVerbose(1); break;
+            default: Usage(argv[0]); return (opt == 'h') ? 0 : 1;
+        }
+    }
+
+    W25qSim_DefaultConfig(&simCfg);
+    if (W25qSim_Init(&simCfg) != 0 || W25x_InitSpiFlash(0, 0) != HDF_SUCCESS) {
+        fprintf(stderr, "flash init failed\n");
+        return 1;
+    }
+#ifdef LOSCFG_NIOBE407_LITTLEFS_CACHE
+    (void)LittlefsCacheInit();
+#endif
+
+    FsBenchPrintHeader();
+    if (cacheSize != 0) {
+        failed = RunCacheSize(cacheSize);
+    } else {
+        for (size_t i = 0; i < sizeof(g_cacheSizes) / sizeof(g_cacheSizes[0]); i++) {
+            failed += RunCacheSize(g_cacheSizes[i]);
+        }
+    }
+#ifdef LOSCFG_NIOBE407_LITTLEFS_CACHE
+    LittlefsCacheDumpStat();
+#endif
+
+    W25x_DeInitSpiFlash();
+    W25qSim_Deinit();
+    return (failed != 0) ? 1 : 0;
+}
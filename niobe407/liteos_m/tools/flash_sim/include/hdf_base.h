@@ -0,0 +1,30 @@
+/*
+ * Copyright (c) 2022 Talkweb Co., Ltd.
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef __HDF_BASE_H__
+#define __HDF_BASE_H__
+
+#define HDF_SUCCESS                 0
+#define HDF_FAILURE                 (-1)
+#define HDF_ERR_NOT_SUPPORT         (-2)
+#define HDF_ERR_INVALID_PARAM       (-3)
+#define HDF_ERR_INVALID_OBJECT      (-4)
+#define HDF_ERR_MALLOC_FAIL         (-6)
+#define HDF_ERR_TIMEOUT             (-7)
+#define HDF_ERR_QUEUE_FULL          (-15)
+#define HDF_ERR_DEVICE_BUSY         (-16)
+#define HDF_ERR_IO                  (-17)
+
+#endif /* __HDF_BASE_H__ */
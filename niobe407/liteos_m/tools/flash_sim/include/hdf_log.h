@@ -0,0 +1,28 @@
+/*
+ * Copyright (c) 2022 Talkweb Co., Ltd.
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef __HDF_LOG_H__
+#define __HDF_LOG_H__
+
+#include <stdio.h>
+#include "hdf_base.h"
+#include "securec.h"
+
+#define HDF_LOGE(fmt, ...) fprintf(stderr, fmt, ##__VA_ARGS__)
+#define HDF_LOGW(fmt, ...) fprintf(stderr, fmt, ##__VA_ARGS__)
+#define HDF_LOGI(fmt, ...) fprintf(stderr, fmt, ##__VA_ARGS__)
+#define HDF_LOGD(fmt, ...)
+
+#endif /* __HDF_LOG_H__ */
@@ -0,0 +1,58 @@
+/*
+ * Copyright (c) 2022 Talkweb Co., Ltd.
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/* host stand-ins for the LiteOS-M kernel calls used by the flash driver */
+
+#ifndef __LOS_HOST_H__
+#define __LOS_HOST_H__
+
+#include <stdint.h>
+#include <stddef.h>
+
+typedef unsigned char UINT8;
+typedef unsigned short UINT16;
+typedef unsigned int UINT32;
+typedef int INT32;
+typedef unsigned long long UINT64;
+typedef char CHAR;
+typedef void VOID;
+typedef unsigned int BOOL;
+
+#ifndef TRUE
+#define TRUE                                1
+#endif
+#ifndef FALSE
+#define FALSE                               0
+#endif
+
+#define LOS_OK                              0
+#define LOS_NOK                             1
+#define LOS_WAIT_FOREVER                    0xFFFFFFFF
+#define LOS_NO_WAIT                         0
+#define LOSCFG_BASE_CORE_TICK_PER_SECOND    (1000UL)
+
+UINT32 LOS_TaskDelay(UINT32 tick);
+UINT64 LOS_TickCountGet(void);
+UINT32 LOS_MS2Tick(UINT32 millisec);
+
+UINT32 LOS_MuxCreate(UINT32 *muxHandle);
+UINT32 LOS_MuxDelete(UINT32 muxHandle);
+UINT32 LOS_MuxPend(UINT32 muxHandle, UINT32 timeout);
+UINT32 LOS_MuxPost(UINT32 muxHandle);
+
+UINT32 LOS_IntLock(VOID);
+VOID LOS_IntRestore(UINT32 intSave);
+
+#endif /* __LOS_HOST_H__ */
@@ -0,0 +1,26 @@
+/*
+ * Copyright (c) 2022 Talkweb Co., Ltd.
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef __SECUREC_H__
+#define __SECUREC_H__
+
+#include <stddef.h>
+
+#define EOK 0
+
+int memset_s(void *dest, size_t destMax, int c, size_t count);
+int memcpy_s(void *dest, size_t destMax, const void *src, size_t count);
+
+#endif /* __SECUREC_H__ */
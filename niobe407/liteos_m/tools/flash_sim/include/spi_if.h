@@ -0,0 +1,53 @@
+/*
+ * Copyright (c) 2022 Talkweb Co., Ltd.
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/* the subset of the hdf spi interface used by the flash driver, served by w25q_sim.c */
+
+#ifndef __SPI_IF_H__
+#define __SPI_IF_H__
+
+#include <stdint.h>
+#include "hdf_base.h"
+
+typedef void *DevHandle;
+
+struct SpiDevInfo {
+    uint32_t busNum;
+    uint32_t csNum;
+};
+
+struct SpiMsg {
+    uint8_t *wbuf;
+    uint8_t *rbuf;
+    uint32_t len;
+    uint32_t speed;
+    uint16_t delayUs;
+    uint8_t keepCs;
+};
+
+struct SpiCfg {
+    uint32_t maxSpeedHz;
+    uint8_t mode;
+    uint8_t transferMode;
+    uint8_t bitsPerWord;
+};
+
+DevHandle SpiOpen(const struct SpiDevInfo *info);
+void SpiClose(DevHandle handle);
+int32_t SpiTransfer(DevHandle handle, struct SpiMsg *msgs, uint32_t count);
+int32_t SpiSetCfg(DevHandle handle, struct SpiCfg *cfg);
+int32_t SpiGetCfg(DevHandle handle, struct SpiCfg *cfg);
+
+#endif /* __SPI_IF_H__ */
@@ -0,0 +1,116 @@
+/*
+ * Copyright (c) 2022 Talkweb Co., Ltd.
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <string.h>
+#include "los_host.h"
+#include "securec.h"
+#include "w25q_sim.h"
+
+/*
+ * Single threaded stand-ins: sleeping advances the simulated clock, mutexes
+ * only track their nesting so unbalanced pend/post shows up.
+ */
+#define HOST_MUX_MAX        16
+#define HOST_NS_PER_TICK    (1000000000ULL / LOSCFG_BASE_CORE_TICK_PER_SECOND)
+
+static struct {
+    BOOL used;
+    UINT32 count;
+} g_hostMux[HOST_MUX_MAX];
+
+UINT32 LOS_TaskDelay(UINT32 tick)
+{
+    W25qSim_Sleep((UINT64)tick * HOST_NS_PER_TICK);
+    return LOS_OK;
+}
+
+UINT64 LOS_TickCountGet(void)
+{
+    return W25qSim_NowNs() / HOST_NS_PER_TICK;
+}
+
+UINT32 LOS_MS2Tick(UINT32 millisec)
+{
+    return (UINT32)((UINT64)millisec * LOSCFG_BASE_CORE_TICK_PER_SECOND / 1000);
+}
+
+UINT32 LOS_MuxCreate(UINT32 *muxHandle)
+{
+    for (UINT32 i = 0; i < HOST_MUX_MAX; i++) {
+        if (!g_hostMux[i].used) {
+            g_hostMux[i].used = TRUE;
+            g_hostMux[i].count = 0;
+            *muxHandle = i;
+            return LOS_OK;
+        }
+    }
+    return LOS_NOK;
+}
+
+UINT32 LOS_MuxDelete(UINT32 muxHandle)
+{
+    if (muxHandle >= HOST_MUX_MAX || !g_hostMux[muxHandle].used || g_hostMux[muxHandle].count != 0) {
+        return LOS_NOK;
+    }
+    g_hostMux[muxHandle].used = FALSE;
+    return LOS_OK;
+}
+
+UINT32 LOS_MuxPend(UINT32 muxHandle, UINT32 timeout)
+{
+    (void)timeout;
+    if (muxHandle >= HOST_MUX_MAX || !g_hostMux[muxHandle].used) {
+        return LOS_NOK;
+    }
+    g_hostMux[muxHandle].count++;
+    return LOS_OK;
+}
+
+UINT32 LOS_MuxPost(UINT32 muxHandle)
+{
+    if (muxHandle >= HOST_MUX_MAX || g_hostMux[muxHandle].count == 0) {
+        return LOS_NOK;
+    }
+    g_hostMux[muxHandle].count--;
+    return LOS_OK;
+}
+
+UINT32 LOS_IntLock(VOID)
+{
+    return 0;
+}
+
+VOID LOS_IntRestore(UINT32 intSave)
+{
+    (void)intSave;
+}
+
+int memset_s(void *dest, size_t destMax, int c, size_t count)
+{
+    if (dest == NULL || count > destMax) {
+        return -1;
+    }
+    memset(dest, c, count);
+    return EOK;
+}
+
+int memcpy_s(void *dest, size_t destMax, const void *src, size_t count)
+{
+    if (dest == NULL || src == NULL || count > destMax) {
+        return -1;
+    }
+    memcpy(dest, src, count);
+    return EOK;
+}
@@ -0,0 +1,557 @@
+/*
+ * Copyright (c) 2022 Talkweb Co., Ltd.
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "spi_if.h"
+#include "w25q_sim.h"
+
+#define SIM_PAGE_SIZE           256
+#define SIM_SECTOR_SIZE         0x1000
+#define SIM_BLOCK32_SIZE        0x8000
+#define SIM_BLOCK64_SIZE        0x10000
+#define SIM_MAX_READ_HZ         50000000    // 0x03 read data limit
+#define SIM_MAX_BAUD_INDEX      7
+#define SIM_NS_PER_US           1000ULL
+#define SIM_NS_PER_SEC          1000000000ULL
+#define SIM_BITS_PER_BYTE       8
+#define SIM_ADDR_BYTES          3
+#define SIM_3BYTE_LIMIT         0x1000000
+#define SIM_SFDP_SIZE           0x100
+#define SIM_WORN_MAX            16
+#define SIM_BFPT_OFFSET         0x80
+#define SIM_BFPT_DWORDS         16
+#define SIM_MANUFACTURER_ID     0xEF
+#define SIM_DEVICE_ID           0x17
+
+#define SR1_WIP                 0x01
+#define SR1_WEL                 0x02
+#define SR2_SUS                 0x80
+
+typedef struct {
+    uint32_t busNum;
+    uint32_t csNum;
+    uint32_t baudIndex;
+} SimHandle;
+
+typedef struct {
+    W25qSimConfig cfg;
+    uint8_t *mem;
+    uint64_t now;
+    int verbose;
+
+    int wel;
+    int powerDown;
+    int addr4;
+    uint64_t busyUntil;
+    int eraseBusy;
+    uint32_t eraseAddr;
+    uint32_t eraseSize;
+    int suspended;
+    uint64_t suspendReady;
+    uint64_t remainingNs;
+
+    /* command frame in progress */
+    int csLow;
+    int ignore;
+    uint8_t op;
+    uint32_t pos;
+    uint32_t addr;
+    uint32_t addrLen;
+    uint8_t page[SIM_PAGE_SIZE];
+    uint8_t touched[SIM_PAGE_SIZE];
+
+    uint8_t sfdp[SIM_SFDP_SIZE];
+    uint32_t worn[SIM_WORN_MAX];
+    uint32_t wornCount;
+    W25qSimStats stats;
+} W25qSim;
+
+static W25qSim g_sim;
+
+void W25qSim_DefaultConfig(W25qSimConfig *cfg)
+{
+    /* W25Q128JV typical timings on SPI1 of the STM32F407, APB2 at 84MHz, baudRate 1 in hdf.hcs */
+    cfg->capacity = 0x1000000;
+    cfg->jedecId = 0xEF4018;
+    cfg->spiKernelHz = 84000000;
+    cfg->baudIndex = 1;
+    cfg->xferOverheadNs = 4000;
+    cfg->byteOverheadNs = 60;
+    cfg->tPageProgramUs = 700;
+    cfg->tSectorEraseUs = 45000;
+    cfg->tBlock32EraseUs = 120000;
+    cfg->tBlock64EraseUs = 150000;
+    cfg->tChipEraseUs = 40000000;
+    cfg->tSuspendUs = 20;
+    cfg->sfdp = 1;
+}
+
+static void SimPutDword(uint8_t *p, uint32_t v)
+{
+    for (int i = 0; i < 4; i++) {
+        p[i] = (uint8_t)(v >> (SIM_BITS_PER_BYTE * i));
+    }
+}
+
+/* sfdp header, one parameter header and the JESD216B basic table of a W25QxxJV */
+static void SimBuildSfdp(uint8_t *sfdp, uint32_t capacity)
+{
+    uint8_t *bfpt = sfdp + SIM_BFPT_OFFSET;
+    int large = capacity > SIM_3BYTE_LIMIT;
+
+    memset(sfdp, 0xFF, SIM_SFDP_SIZE);
+    memcpy(sfdp, "SFDP", 4);
+    sfdp[4] = 0x06;                         // JESD216B
+    sfdp[5] = 0x01;
+    sfdp[6] = 0x00;                         // one parameter header
+    sfdp[8] = 0x00;                         // basic flash parameter table
+    sfdp[9] = 0x06;
+    sfdp[10] = 0x01;
+    sfdp[11] = SIM_BFPT_DWORDS;
+    sfdp[12] = SIM_BFPT_OFFSET;
+    sfdp[13] = 0x00;
+    sfdp[14] = 0x00;
+    sfdp[15] = 0xFF;
+
+    /* 4KB erase 0x20, 1-1-2/1-2-2/1-4-4/1-1-4 reads, 3 or 4 byte address above 16MB */
+    SimPutDword(bfpt + 0, 0xFF7120E5 | (large ? (1U << 17) : 0));
+    SimPutDword(bfpt + 4, capacity * SIM_BITS_PER_BYTE - 1);
+    SimPutDword(bfpt + 8, 0x6B08EB44);
+    SimPutDword(bfpt + 12, 0xBB423B08);
+    SimPutDword(bfpt + 16, 0xFFFFFFEE);
+    SimPutDword(bfpt + 20, 0xFF00FFFF);
+    SimPutDword(bfpt + 24, 0xEB40FFFF);
+    SimPutDword(bfpt + 28, 0x520F200C);     // 4KB 0x20, 32KB 0x52
+    SimPutDword(bfpt + 32, 0xFF00D810);     // 64KB 0xD8
+    SimPutDword(bfpt + 36, 0xD90BA442);
+    SimPutDword(bfpt + 40, 0x00A60082);     // 256 byte page
+    SimPutDword(bfpt + 44, 0xD804EA14);
+    SimPutDword(bfpt + 48, 0x7A757A75);
+    SimPutDword(bfpt + 52, 0x5CD5BDF7);
+    SimPutDword(bfpt + 56, 0xFF820F19);
+    SimPutDword(bfpt + 60, large ? 0xA1E8F000 : 0x0000F000); // 0xB7 enters 4-byte mode
+}
+
+int W25qSim_Init(const W25qSimConfig *cfg)
+{
+    W25qSim_Deinit();
+    if (cfg->capacity == 0 || (cfg->capacity & (cfg->capacity - 1)) != 0) {
+        fprintf(stderr, "w25q_sim: capacity 0x%x is not a power of two\n", cfg->capacity);
+        return -1;
+    }
+    g_sim.cfg = *cfg;
+    g_sim.mem = malloc(cfg->capacity);
+    if (g_sim.mem == NULL) {
+        return -1;
+    }
+    memset(g_sim.mem, 0xFF, cfg->capacity);
+    if (cfg->sfdp) {
+        SimBuildSfdp(g_sim.sfdp, cfg->capacity);
+    } else {
+        memset(g_sim.sfdp, 0xFF, sizeof(g_sim.sfdp));
+    }
+    return 0;
+}
+
+void W25qSim_Deinit(void)
+{
+    free(g_sim.mem);
+    memset(&g_sim, 0, sizeof(g_sim));
+}
+
+int W25qSim_WearOut(uint32_t addr)
+{
+    if (g_sim.wornCount >= SIM_WORN_MAX || addr >= g_sim.cfg.capacity) {
+        return -1;
+    }
+    g_sim.worn[g_sim.wornCount++] = addr;
+    g_sim.mem[addr] = 0x00;
+    return 0;
+}
+
+uint8_t *W25qSim_Memory(void)
+{
+    return g_sim.mem;
+}
+
+void W25qSim_GetStats(W25qSimStats *stats)
+{
+    *stats = g_sim.stats;
+}
+
+void W25qSim_ResetStats(void)
+{
+    memset(&g_sim.stats, 0, sizeof(g_sim.stats));
+}
+
+void W25qSim_SetVerbose(int verbose)
+{
+    g_sim.verbose = verbose;
+}
+
+uint64_t W25qSim_NowNs(void)
+{
+    return g_sim.now;
+}
+
+void W25qSim_Sleep(uint64_t ns)
+{
+    g_sim.now += ns;
+    g_sim.stats.sleepNs += ns;
+}
+
+static void SimError(const char *what)
+{
+    g_sim.stats.protocolErrors++;
+    if (g_sim.verbose) {
+        fprintf(stderr, "w25q_sim: op 0x%02x at %llu ns: %s\n", g_sim.op, (unsigned long long)g_sim.now, what);
+    }
+}
+
+static int SimBusy(void)
+{
+    if (g_sim.suspended) {
+        return g_sim.now < g_sim.suspendReady;
+    }
+    return g_sim.now < g_sim.busyUntil;
+}
+
+static void SimStartBusy(uint32_t us, int erase, uint32_t addr, uint32_t size)
+{
+    uint64_t ns = us * SIM_NS_PER_US;
+    g_sim.busyUntil = g_sim.now + ns;
+    g_sim.eraseBusy = erase;
+    g_sim.eraseAddr = addr;
+    g_sim.eraseSize = size;
+    g_sim.stats.busyNs += ns;
+    g_sim.wel = 0;
+}
+
+/* commands the part accepts while a program/erase runs or is suspended */
+static int SimAllowedWhileBusy(uint8_t op)
+{
+    return op == 0x05 || op == 0x35 || op == 0x75;
+}
+
+static int SimAllowedWhileSuspended(uint8_t op)
+{
+    switch (op) {
+        case 0x03: case 0x0B: case 0x05: case 0x35: case 0x7A: case 0x5A:
+        case 0x9F: case 0x90: case 0xAB: case 0x06: case 0x04:
+            return 1;
+        default:
+            return 0;
+    }
+}
+
+/* address bytes after the opcode, sfdp and the id commands stay at 3 in 4-byte mode */
+static uint32_t SimAddrLen(uint8_t op)
+{
+    switch (op) {
+        case 0x03: case 0x0B: case 0x02: case 0x20: case 0x52: case 0xD8:
+            return g_sim.addr4 ? SIM_ADDR_BYTES + 1 : SIM_ADDR_BYTES;
+        default:
+            return SIM_ADDR_BYTES;
+    }
+}
+
+static void SimFrameStart(uint8_t op)
+{
+    g_sim.op = op;
+    g_sim.addrLen = SimAddrLen(op);
+    g_sim.ignore = 0;
+    memset(g_sim.touched, 0, sizeof(g_sim.touched));
+    g_sim.stats.frames++;
+    if (g_sim.powerDown && op != 0xAB) {
+        SimError("command while powered down");
+        g_sim.ignore = 1;
+    } else if (SimBusy() && !SimAllowedWhileBusy(op)) {
+        SimError("command while busy");
+        g_sim.ignore = 1;
+    } else if (g_sim.suspended && !SimAllowedWhileSuspended(op) && !SimAllowedWhileBusy(op)) {
+        SimError("command not allowed during erase suspend");
+        g_sim.ignore = 1;
+    }
+    if (op == 0x05) {
+        g_sim.stats.statusPolls++;
+    }
+}
+
+static uint8_t SimStatus1(void)
+{
+    return (SimBusy() ? SR1_WIP : 0) | (g_sim.wel ? SR1_WEL : 0);
+}
+
+static uint8_t SimReadByte(void)
+{
+    uint32_t addr = g_sim.addr & (g_sim.cfg.capacity - 1);
+    if (g_sim.suspended && addr >= g_sim.eraseAddr && addr < g_sim.eraseAddr + g_sim.eraseSize) {
+        SimError("read inside the suspended erase");
+    }
+    g_sim.addr++;
+    return g_sim.mem[addr];
+}
+
+/* one byte clocked in on MOSI, returns what goes out on MISO */
+static uint8_t SimByte(uint8_t in, uint32_t hz)
+{
+    uint32_t pos = g_sim.pos++;
+    uint32_t id = g_sim.cfg.jedecId;
+
+    if (pos == 0) {
+        SimFrameStart(in);
+        if (g_sim.op == 0x03 && hz > SIM_MAX_READ_HZ) {
+            SimError("0x03 read above 50MHz");
+        }
+        return 0xFF;
+    }
+    if (g_sim.ignore) {
+        return 0xFF;
+    }
+    uint32_t alen = g_sim.addrLen;
+    if (pos <= alen) {
+        g_sim.addr = (g_sim.addr << SIM_BITS_PER_BYTE) | in;
+    }
+
+    switch (g_sim.op) {
+        case 0x05:
+            return SimStatus1();
+        case 0x35:
+            return g_sim.suspended ? SR2_SUS : 0;
+        case 0x9F:
+            return (pos <= SIM_ADDR_BYTES) ? (uint8_t)(id >> (SIM_BITS_PER_BYTE * (SIM_ADDR_BYTES - pos))) : 0xFF;
+        case 0xAB:
+            return (pos > SIM_ADDR_BYTES) ? SIM_DEVICE_ID : 0xFF;
+        case 0x90:
+            if (pos > SIM_ADDR_BYTES) {
+                return ((pos - SIM_ADDR_BYTES) & 1) ? SIM_MANUFACTURER_ID : SIM_DEVICE_ID;
+            }
+            return 0xFF;
+        case 0x03:
+            return (pos > alen) ? SimReadByte() : 0xFF;
+        case 0x0B:
+            return (pos > alen + 1) ? SimReadByte() : 0xFF;
+        case 0x5A:
+            return (pos > alen + 1) ? g_sim.sfdp[g_sim.addr++ % SIM_SFDP_SIZE] : 0xFF;
+        case 0x02:
+            if (pos > alen) {
+                /* the page buffer wraps around like the real part */
+                uint32_t col = (g_sim.addr + pos - alen - 1) % SIM_PAGE_SIZE;
+                g_sim.page[col] = in;
+                g_sim.touched[col] = 1;
+            }
+            return 0xFF;
+        default:
+            return 0xFF;
+    }
+}
+
+static void SimErase(uint32_t size, uint32_t us)
+{
+    uint32_t addr = (g_sim.addr & (g_sim.cfg.capacity - 1)) & ~(size - 1);
+    memset(g_sim.mem + addr, 0xFF, size);
+    for (uint32_t i = 0; i < g_sim.wornCount; i++) {
+        if (g_sim.worn[i] >= addr && g_sim.worn[i] - addr < size) {
+            g_sim.mem[g_sim.worn[i]] = 0x00;
+        }
+    }
+    g_sim.stats.erases++;
+    SimStartBusy(us, 1, addr, size);
+}
+
+static void SimProgram(void)
+{
+    uint32_t base = (g_sim.addr & (g_sim.cfg.capacity - 1)) & ~(SIM_PAGE_SIZE - 1);
+    int unerased = 0;
+    for (uint32_t col = 0; col < SIM_PAGE_SIZE; col++) {
+        if (!g_sim.touched[col]) {
+            continue;
+        }
+        if ((g_sim.page[col] & ~g_sim.mem[base + col]) != 0) {
+            unerased = 1;
+        }
+        g_sim.mem[base + col] &= g_sim.page[col];
+    }
+    g_sim.stats.unerasedPrograms += unerased;
+    g_sim.stats.pagePrograms++;
+    SimStartBusy(g_sim.cfg.tPageProgramUs, 0, 0, 0);
+}
+
+static int SimNeedsWel(uint32_t minPos)
+{
+    minPos += g_sim.addrLen - SIM_ADDR_BYTES;
+    if (g_sim.pos < minPos) {
+        SimError("command cut short");
+        return 0;
+    }
+    if (!g_sim.wel) {
+        SimError("program/erase without write enable");
+        return 0;
+    }
+    if (g_sim.suspended) {
+        SimError("program/erase during erase suspend");
+        return 0;
+    }
+    return 1;
+}
+
+/* cs goes high, commands that act on the whole frame execute here */
+static void SimFrameEnd(void)
+{
+    g_sim.csLow = 0;
+    if (g_sim.ignore || g_sim.pos == 0) {
+        return;
+    }
+    switch (g_sim.op) {
+        case 0x06:
+            g_sim.wel = 1;
+            break;
+        case 0x04:
+            g_sim.wel = 0;
+            break;
+        case 0x02:
+            if (SimNeedsWel(SIM_ADDR_BYTES + 2)) {
+                SimProgram();
+            }
+            break;
+        case 0x20:
+            if (SimNeedsWel(SIM_ADDR_BYTES + 1)) {
+                SimErase(SIM_SECTOR_SIZE, g_sim.cfg.tSectorEraseUs);
+            }
+            break;
+        case 0x52:
+            if (SimNeedsWel(SIM_ADDR_BYTES + 1)) {
+                SimErase(SIM_BLOCK32_SIZE, g_sim.cfg.tBlock32EraseUs);
+            }
+            break;
+        case 0xD8:
+            if (SimNeedsWel(SIM_ADDR_BYTES + 1)) {
+                SimErase(SIM_BLOCK64_SIZE, g_sim.cfg.tBlock64EraseUs);
+            }
+            break;
+        case 0xC7:
+        case 0x60:
+            if (SimNeedsWel(1)) {
+                g_sim.addr = 0;
+                SimErase(g_sim.cfg.capacity, g_sim.cfg.tChipEraseUs);
+            }
+            break;
+        case 0x75:
+            if (!SimBusy() || !g_sim.eraseBusy || g_sim.suspended) {
+                break; // ignored by the part when nothing can be suspended
+            }
+            g_sim.suspended = 1;
+            g_sim.remainingNs = g_sim.busyUntil - g_sim.now;
+            g_sim.suspendReady = g_sim.now + g_sim.cfg.tSuspendUs * SIM_NS_PER_US;
+            g_sim.stats.suspends++;
+            break;
+        case 0x7A:
+            if (g_sim.suspended) {
+                uint64_t from = (g_sim.now > g_sim.suspendReady) ? g_sim.now : g_sim.suspendReady;
+                g_sim.suspended = 0;
+                g_sim.busyUntil = from + g_sim.remainingNs;
+            }
+            break;
+        case 0xB7:
+            g_sim.addr4 = 1;
+            break;
+        case 0xE9:
+            g_sim.addr4 = 0;
+            break;
+        case 0xB9:
+            g_sim.powerDown = 1;
+            break;
+        case 0xAB:
+            g_sim.powerDown = 0;
+            break;
+        default:
+            break;
+    }
+}
+
+DevHandle SpiOpen(const struct SpiDevInfo *info)
+{
+    if (g_sim.mem == NULL || info == NULL) {
+        return NULL;
+    }
+    SimHandle *handle = calloc(1, sizeof(SimHandle));
+    if (handle == NULL) {
+        return NULL;
+    }
+    handle->busNum = info->busNum;
+    handle->csNum = info->csNum;
+    handle->baudIndex = g_sim.cfg.baudIndex;
+    return handle;
+}
+
+void SpiClose(DevHandle handle)
+{
+    free(handle);
+}
+
+int32_t SpiGetCfg(DevHandle handle, struct SpiCfg *cfg)
+{
+    if (handle == NULL || cfg == NULL) {
+        return HDF_ERR_INVALID_PARAM;
+    }
+    memset(cfg, 0, sizeof(*cfg));
+    cfg->maxSpeedHz = ((SimHandle *)handle)->baudIndex; // the niobe407 driver takes the prescaler index here
+    cfg->bitsPerWord = SIM_BITS_PER_BYTE;
+    return HDF_SUCCESS;
+}
+
+int32_t SpiSetCfg(DevHandle handle, struct SpiCfg *cfg)
+{
+    if (handle == NULL || cfg == NULL || cfg->maxSpeedHz > SIM_MAX_BAUD_INDEX) {
+        return HDF_ERR_INVALID_PARAM;
+    }
+    ((SimHandle *)handle)->baudIndex = cfg->maxSpeedHz;
+    return HDF_SUCCESS;
+}
+
+int32_t SpiTransfer(DevHandle handle, struct SpiMsg *msgs, uint32_t count)
+{
+    if (handle == NULL || msgs == NULL || g_sim.mem == NULL) {
+        return HDF_ERR_INVALID_PARAM;
+    }
+    uint32_t hz = g_sim.cfg.spiKernelHz >> (((SimHandle *)handle)->baudIndex + 1);
+    uint64_t byteNs = SIM_BITS_PER_BYTE * SIM_NS_PER_SEC / hz + g_sim.cfg.byteOverheadNs;
+
+    g_sim.stats.xfers++;
+    g_sim.now += g_sim.cfg.xferOverheadNs;
+    for (uint32_t i = 0; i < count; i++) {
+        struct SpiMsg *msg = &msgs[i];
+        if (!g_sim.csLow) {
+            g_sim.csLow = 1;
+            g_sim.pos = 0;
+            g_sim.addr = 0;
+        }
+        for (uint32_t j = 0; j < msg->len; j++) {
+            uint8_t out = SimByte((msg->wbuf != NULL) ? msg->wbuf[j] : 0xFF, hz);
+            if (msg->rbuf != NULL) {
+                msg->rbuf[j] = out;
+            }
+            g_sim.now += byteNs;
+        }
+        g_sim.stats.bytes += msg->len;
+        if (!msg->keepCs) {
+            SimFrameEnd();
+        }
+        g_sim.now += msg->delayUs * SIM_NS_PER_US;
+    }
+    return HDF_SUCCESS;
+}
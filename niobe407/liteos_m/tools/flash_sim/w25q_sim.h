@@ -0,0 +1,70 @@
+/*
+ * Copyright (c) 2022 Talkweb Co., Ltd.
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef __W25Q_SIM_H__
+#define __W25Q_SIM_H__
+
+#include <stdint.h>
+
+/*
+ * RAM backed W25Qxx behind the hdf spi interface. Time is virtual: every
+ * transfer advances it by the wire time at the configured clock, LOS_TaskDelay
+ * advances it by the sleep, and program/erase stay busy until it has passed
+ * their duration.
+ */
+typedef struct {
+    uint32_t capacity;          // bytes, power of two
+    uint32_t jedecId;           // 0xEF4018 for W25Q128
+    uint32_t spiKernelHz;       // APB clock in front of the spi prescaler
+    uint32_t baudIndex;         // prescaler at SpiOpen, 0:div2 1:div4 ... as in hdf.hcs
+    uint32_t xferOverheadNs;    // software cost of one SpiTransfer call
+    uint32_t byteOverheadNs;    // software cost per byte on top of the wire time
+    uint32_t tPageProgramUs;
+    uint32_t tSectorEraseUs;
+    uint32_t tBlock32EraseUs;
+    uint32_t tBlock64EraseUs;
+    uint32_t tChipEraseUs;
+    uint32_t tSuspendUs;        // erase suspend until WIP clears
+    int sfdp;                   // answer 0x5A with a W25QxxJV table, else 0xFF like parts without sfdp
+} W25qSimConfig;
+
+typedef struct {
+    uint64_t xfers;             // SpiTransfer calls
+    uint64_t frames;            // commands, cs low to cs high
+    uint64_t bytes;             // bytes clocked on the bus
+    uint64_t statusPolls;
+    uint64_t pagePrograms;
+    uint64_t erases;
+    uint64_t suspends;
+    uint64_t busyNs;            // time the flash was programming or erasing
+    uint64_t sleepNs;           // time the driver spent in LOS_TaskDelay
+    uint64_t protocolErrors;    // commands the real part would ignore or corrupt
+    uint64_t unerasedPrograms;  // page programs that tried to turn a 0 bit into 1
+} W25qSimStats;
+
+void W25qSim_DefaultConfig(W25qSimConfig *cfg);
+int W25qSim_Init(const W25qSimConfig *cfg);
+void W25qSim_Deinit(void);
+uint8_t *W25qSim_Memory(void);
+/* the byte at addr stays 0x00 through every erase, like a worn out cell */
+int W25qSim_WearOut(uint32_t addr);
+void W25qSim_GetStats(W25qSimStats *stats);
+void W25qSim_ResetStats(void);
+void W25qSim_SetVerbose(int verbose);
+
+uint64_t W25qSim_NowNs(void);
+void W25qSim_Sleep(uint64_t ns);
+
+#endif /* __W25Q_SIM_H__ */
@@ -0,0 +1,115 @@
+/*
+ * Copyright (c) 2022 Talkweb Co., Ltd.
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+#include "ring_buffer.h"
+
+#define BENCH_BYTES     (64 * 1024 * 1024)
+#define BENCH_RING      1024
+#define BENCH_CHUNK     64  // what one rx interrupt or dma half transfer hands over
+
+/* cycles where the cpu has a counter the host can read, nanoseconds otherwise */
+static uint64_t BenchNow(void)
+{
+#if defined(__x86_64__) || defined(__i386__)
+    return __rdtsc();
+#else
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+#endif
+}
+
+static unsigned char g_in[BENCH_CHUNK];
+static unsigned char g_out[BENCH_CHUNK];
+static volatile uint32_t g_sink;
+
+static void ByteRun(RingBuffer *ring)
+{
+    for (uint32_t done = 0; done < BENCH_BYTES; done += BENCH_CHUNK) {
+        for (int i = 0; i < BENCH_CHUNK; i++) {
+            (void)RingBufWrite(ring, g_in[i]);
+        }
+        for (int i = 0; i < BENCH_CHUNK; i++) {
+            (void)RingBufRead(ring, &g_out[i]);
+        }
+    }
+}
+
+static void ManyRun(RingBuffer *ring)
+{
+    for (uint32_t done = 0; done < BENCH_BYTES; done += BENCH_CHUNK) {
+        (void)RingBufWriteMany(ring, g_in, BENCH_CHUNK);
+        (void)RingBufReadMany(ring, g_out, BENCH_CHUNK);
+    }
+}
+
+/* the consumer parses in place instead of copying out */
+static void PeekRun(RingBuffer *ring)
+{
+    unsigned char *p = NULL;
+    uint32_t sum = 0;
+
+    for (uint32_t done = 0; done < BENCH_BYTES; done += BENCH_CHUNK) {
+        (void)RingBufWriteMany(ring, g_in, BENCH_CHUNK);
+        uint32_t n;
+        while ((n = RingBufPeekRead(ring, &p)) != 0) {
+            sum += p[0] + p[n - 1];
+            RingBufCommitRead(ring, n);
+        }
+    }
+    g_sink = sum;
+}
+
+int main(void)
+{
+    static const struct {
+        const char *name;
+        void (*run)(RingBuffer *ring);
+    } cases[] = {
+        {"byte", ByteRun},
+        {"many", ManyRun},
+        {"peek_commit", PeekRun},
+    };
+#if defined(__x86_64__) || defined(__i386__)
+    const char *unit = "cycle";
+#else
+    const char *unit = "ns";
+#endif
+
+    for (int i = 0; i < BENCH_CHUNK; i++) {
+        g_in[i] = (unsigned char)i;
+    }
+    printf("ringbench,case,bytes,chunk,ticks,bytes_per_%s\n", unit);
+    for (size_t c = 0; c < sizeof(cases) / sizeof(cases[0]); c++) {
+        RingBuffer *ring = RingBufInit(BENCH_RING);
+        if (ring == NULL) {
+            return 1;
+        }
+        ring->posR = ring->posW = 0xFFFFF000; // run across the index wrap too
+        uint64_t start = BenchNow();
+        cases[c].run(ring);
+        uint64_t ticks = BenchNow() - start;
+        printf("ringbench,%s,%u,%u,%llu,%.3f\n", cases[c].name, BENCH_BYTES, BENCH_CHUNK,
+            (unsigned long long)ticks, (ticks != 0) ? (double)BENCH_BYTES / ticks : 0.0);
+        free(ring);
+    }
+    return 0;
+}
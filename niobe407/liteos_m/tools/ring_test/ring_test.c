@@ -0,0 +1,197 @@
+/*
+ * Copyright (c) 2022 Talkweb Co., Ltd.
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <pthread.h>
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "ring_buffer.h"
+
+#define STRESS_BYTES    (4 * 1024 * 1024)
+#define STRESS_RING     128
+
+static int g_failed = 0;
+
+#define CHECK(cond) do { \
+    if (!(cond)) { \
+        printf("%s:%d: %s failed\n", __func__, __LINE__, #cond); \
+        g_failed++; \
+    } \
+} while (0)
+
+static void TestInit(void)
+{
+    RingBuffer *ring = RingBufInit(100);
+
+    CHECK(RingBufInit(0) == NULL);
+    CHECK(ring != NULL && ring->size == 128 && ring->mask == 127);
+    CHECK(RingBufUsed(ring) == 0 && RingBufFree(ring) == 128);
+    free(ring);
+    ring = RingBufInit(64);
+    CHECK(ring != NULL && ring->size == 64);
+    free(ring);
+}
+
+static void TestSingleByte(void)
+{
+    RingBuffer *ring = RingBufInit(8);
+    unsigned char data;
+
+    CHECK(RingBufRead(ring, &data) == -1);
+    for (int round = 0; round < 5; round++) {
+        for (int i = 0; i < 8; i++) {
+            CHECK(RingBufWrite(ring, (unsigned char)(round * 8 + i)) == 0);
+        }
+        CHECK(RingBufWrite(ring, 0xAA) == -1);
+        CHECK(RingBufUsed(ring) == 8);
+        for (int i = 0; i < 8; i++) {
+            CHECK(RingBufRead(ring, &data) == 0 && data == (unsigned char)(round * 8 + i));
+        }
+        CHECK(RingBufRead(ring, &data) == -1);
+    }
+    free(ring);
+}
+
+/* the indices run past 2^32 without the used count going wrong */
+static void TestIndexWrap(void)
+{
+    RingBuffer *ring = RingBufInit(16);
+    unsigned char in[12];
+    unsigned char out[12];
+
+    ring->posR = ring->posW = 0xFFFFFFF8;
+    for (int i = 0; i < 12; i++) {
+        in[i] = (unsigned char)(0x30 + i);
+    }
+    CHECK(RingBufWriteMany(ring, in, 12) == 12);
+    CHECK(ring->posW == 4 && RingBufUsed(ring) == 12);
+    CHECK(RingBufReadMany(ring, out, 12) == 12 && memcmp(in, out, 12) == 0);
+    CHECK(RingBufUsed(ring) == 0);
+    free(ring);
+}
+
+static void TestBulk(void)
+{
+    RingBuffer *ring = RingBufInit(32);
+    unsigned char in[48];
+    unsigned char out[48];
+
+    for (int i = 0; i < 48; i++) {
+        in[i] = (unsigned char)i;
+    }
+    CHECK(RingBufWriteMany(ring, in, 20) == 20);
+    CHECK(RingBufReadMany(ring, out, 16) == 16 && memcmp(out, in, 16) == 0);
+    /* wraps: 4 left, 28 free split over the end of the buffer */
+    CHECK(RingBufWriteMany(ring, in + 20, 28) == 28);
+    CHECK(RingBufWriteMany(ring, in, 1) == 0);
+    CHECK(RingBufReadMany(ring, out, 48) == 32 && memcmp(out, in + 16, 32) == 0);
+    CHECK(RingBufReadMany(ring, out, 48) == 0);
+    CHECK(RingBufWriteMore(ring, in, 48) == 0 && RingBufUsed(ring) == 32);
+    free(ring);
+}
+
+static void TestPeekCommit(void)
+{
+    RingBuffer *ring = RingBufInit(16);
+    unsigned char *p = NULL;
+    unsigned char tmp[16];
+
+    CHECK(RingBufPeekRead(ring, &p) == 0);
+    CHECK(RingBufPeekWrite(ring, &p) == 16 && p == ring->buf);
+    memset(p, 0x11, 10);
+    RingBufCommitWrite(ring, 10);
+    CHECK(RingBufPeekRead(ring, &p) == 10 && p[0] == 0x11 && p[9] == 0x11);
+    RingBufCommitRead(ring, 10);
+    /* contiguous space ends at the end of the buffer, the rest comes on the next peek */
+    CHECK(RingBufPeekWrite(ring, &p) == 6 && p == ring->buf + 10);
+    memset(p, 0x22, 6);
+    RingBufCommitWrite(ring, 6);
+    CHECK(RingBufPeekWrite(ring, &p) == 10 && p == ring->buf);
+    memset(p, 0x33, 4);
+    RingBufCommitWrite(ring, 4);
+    CHECK(RingBufPeekRead(ring, &p) == 6 && p[0] == 0x22);
+    CHECK(RingBufReadMany(ring, tmp, 16) == 10 && tmp[5] == 0x22 && tmp[6] == 0x33 && tmp[9] == 0x33);
+    free(ring);
+}
+
+static void *StressProducer(void *arg)
+{
+    RingBuffer *ring = arg;
+    unsigned char chunk[37];
+    uint32_t sent = 0;
+
+    while (sent < STRESS_BYTES) {
+        uint32_t want = (STRESS_BYTES - sent < sizeof(chunk)) ? (STRESS_BYTES - sent) : sizeof(chunk);
+        want = (sent & 1) ? want : 1;   // mix single and bulk writes
+        for (uint32_t i = 0; i < want; i++) {
+            chunk[i] = (unsigned char)((sent + i) * 7 + ((sent + i) >> 11));
+        }
+        uint32_t n = (want == 1) ? (RingBufWrite(ring, chunk[0]) == 0) : RingBufWriteMany(ring, chunk, want);
+        if (n == 0) {
+            (void)sched_yield();    // full, let the reader run on a single core host
+        }
+        sent += n;
+    }
+    return NULL;
+}
+
+/* one writer thread, one reader thread, the pattern has to come out in order */
+static void TestStress(void)
+{
+    RingBuffer *ring = RingBufInit(STRESS_RING);
+    pthread_t producer;
+    unsigned char chunk[53];
+    unsigned char *p = NULL;
+    uint32_t got = 0;
+    uint32_t errors = 0;
+
+    CHECK(pthread_create(&producer, NULL, StressProducer, ring) == 0);
+    while (got < STRESS_BYTES) {
+        uint32_t n;
+        if (got & 2) {
+            n = RingBufReadMany(ring, chunk, sizeof(chunk));
+            for (uint32_t i = 0; i < n; i++) {
+                errors += (chunk[i] != (unsigned char)((got + i) * 7 + ((got + i) >> 11)));
+            }
+        } else {
+            n = RingBufPeekRead(ring, &p);
+            for (uint32_t i = 0; i < n; i++) {
+                errors += (p[i] != (unsigned char)((got + i) * 7 + ((got + i) >> 11)));
+            }
+            RingBufCommitRead(ring, n);
+        }
+        if (n == 0) {
+            (void)sched_yield();
+        }
+        got += n;
+    }
+    pthread_join(producer, NULL);
+    CHECK(errors == 0);
+    CHECK(RingBufUsed(ring) == 0);
+    free(ring);
+}
+
+int main(void)
+{
+    TestInit();
+    TestSingleByte();
+    TestIndexWrap();
+    TestBulk();
+    TestPeekCommit();
+    TestStress();
+    printf("ring_test: %d checks failed\n", g_failed);
+    return (g_failed == 0) ? 0 : 1;
+}